@@ -0,0 +1,152 @@
+#ifndef BOARD_SYNC_HPP
+#define BOARD_SYNC_HPP
+
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "card3_5.hpp"
+
+// 栏位中一个格子的可见状态，只记录比较所需的字段，不做序列化
+// card为空表示该格子没有存活的卡牌（客户端显示为null）
+struct CellState {
+    const Card* card = nullptr;
+    int card_id = 0;
+    int hp = 0;
+
+    bool empty() const { return card == nullptr; }
+};
+
+using BoardView = std::vector<std::vector<CellState>>;
+
+// 与move_accepted/opponent_move中的可见规则一致：已上场且HP>0的卡牌才显示
+inline BoardView capture_board(const std::vector<std::vector<Card*>>& slots_cards) {
+    BoardView view(slots_cards.size());
+    for (size_t slot = 0; slot < slots_cards.size(); ++slot) {
+        view[slot].reserve(slots_cards[slot].size());
+        for (Card* card : slots_cards[slot]) {
+            CellState cell;
+            if (card && card->get_card_state() != 0 && card->getHP() > 0) {
+                cell.card = card;
+                cell.card_id = card->get_play_current_card_id();
+                cell.hp = card->getHP();
+            }
+            view[slot].push_back(cell);
+        }
+    }
+    return view;
+}
+
+// 一名接收方看到的一块棋盘（己方或对方）的增量同步状态
+// 基准是客户端通过board_ack确认过的视图，增量中的每一项都是“把格子设为X”的绝对值，
+// 所以基准之后任意一条增量丢失或被下行队列合并替代，新的增量在客户端上仍然得到正确结果
+// 没有已确认的基准、距上一个关键帧已发出kKeyframeInterval条增量，或未确认的视图积压过多时发送完整关键帧，
+// 积压过多时同时丢弃未确认的视图，每个接收方最多保留kMaxPending份
+class BoardSync {
+public:
+    static constexpr size_t kKeyframeInterval = 16;
+    static constexpr size_t kMaxPending = 32;
+
+    // 返回本次应下发的board字段；seq为这条消息将要使用的下行序号，compact为true时卡牌用紧凑格式
+    nlohmann::json encode(const BoardView& view, uint64_t seq, bool compact = false) {
+        nlohmann::json board;
+        if (!has_base_ || since_keyframe_ >= kKeyframeInterval || pending_.size() >= kMaxPending) {
+            // 客户端长期不确认时旧视图已无用：关键帧不依赖基准，确认它即可得到新基准
+            if (pending_.size() >= kMaxPending) pending_.clear();
+            board["keyframe"] = true;
+            board["slots"] = keyframe_slots(view, compact);
+            since_keyframe_ = 0;
+        } else {
+            board["keyframe"] = false;
+            board["base_seq"] = base_seq_;
+            board["changes"] = diff(base_, view, compact);
+            nlohmann::json sizes = nlohmann::json::array();
+            bool resized = base_.size() != view.size();
+            for (size_t slot = 0; slot < view.size(); ++slot) {
+                sizes.push_back(view[slot].size());
+                if (!resized && base_[slot].size() != view[slot].size()) resized = true;
+            }
+            if (resized) board["sizes"] = sizes;
+            ++since_keyframe_;
+        }
+        pending_[seq] = view;
+        return board;
+    }
+
+    // 客户端确认收到seq及之前的所有下行消息
+    void ack(uint64_t seq) {
+        auto it = pending_.upper_bound(seq);
+        if (it == pending_.begin()) return;
+        auto acked = std::prev(it);
+        base_ = std::move(acked->second);
+        base_seq_ = acked->first;
+        has_base_ = true;
+        pending_.erase(pending_.begin(), it);
+    }
+
+    // 重连或发送状态快照后，客户端的棋盘状态未知，下一条必须是关键帧
+    void reset() {
+        has_base_ = false;
+        base_.clear();
+        base_seq_ = 0;
+        pending_.clear();
+        since_keyframe_ = 0;
+    }
+
+private:
+    static nlohmann::json cell_json(const CellState& cell, bool compact) {
+        if (cell.empty()) return nullptr;
+        return compact ? cell.card->toCompactJson() : cell.card->toJson();
+    }
+
+    static nlohmann::json keyframe_slots(const BoardView& view, bool compact) {
+        nlohmann::json slots = nlohmann::json::array();
+        for (const auto& slot : view) {
+            nlohmann::json slot_json = nlohmann::json::array();
+            for (const auto& cell : slot) {
+                slot_json.push_back(cell_json(cell, compact));
+            }
+            slots.push_back(slot_json);
+        }
+        return slots;
+    }
+
+    // 只对新放置的卡牌调用toJson；同一张牌只变了HP时发hp，格子变空时发remove
+    static nlohmann::json diff(const BoardView& base, const BoardView& view, bool compact) {
+        nlohmann::json changes = nlohmann::json::array();
+        for (size_t slot = 0; slot < view.size(); ++slot) {
+            for (size_t pos = 0; pos < view[slot].size(); ++pos) {
+                const CellState& now = view[slot][pos];
+                const CellState* was = nullptr;
+                if (slot < base.size() && pos < base[slot].size()) was = &base[slot][pos];
+
+                nlohmann::json change;
+                if (now.empty()) {
+                    if (!was || was->empty()) continue;
+                    change["op"] = "remove";
+                } else if (!was || was->card != now.card || was->card_id != now.card_id) {
+                    change["op"] = "place";
+                    change["card"] = cell_json(now, compact);
+                } else if (was->hp != now.hp) {
+                    change["op"] = "hp";
+                    change["HP"] = now.hp;
+                } else {
+                    continue;
+                }
+                change["slot"] = slot;
+                change["pos"] = pos;
+                changes.push_back(change);
+            }
+        }
+        return changes;
+    }
+
+    bool has_base_ = false;
+    BoardView base_;
+    uint64_t base_seq_ = 0;
+    std::map<uint64_t, BoardView> pending_; // 已发出但未确认的视图，按seq排序
+    size_t since_keyframe_ = 0;
+};
+
+#endif
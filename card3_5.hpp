@@ -2,6 +2,8 @@
 #ifndef CARD_HPP
 #define CARD_HPP
 
+#include <cstdint>
+#include <cstdio>
 #include <iostream>
 #include <memory>
 #include <random>
@@ -14,9 +16,12 @@
 #include <vector>
 #include <string>
 #include <atomic>
+#include <sstream>
 #include <websocketpp/config/asio_no_tls.hpp>
 #include <websocketpp/server.hpp>
 #include <nlohmann/json.hpp>
+#include "wire_codec1_0.hpp"
+#include "protocol1_0.hpp"
 
 
 //数字实现基本功能game_interface1_2_4  同时解决-1和其他数字被对方看到的问题
@@ -33,11 +38,23 @@ protected:
     // bool play_current=true;
     int card_id=0;
     int card_state=0;
+    int def_id=-1;//卡牌目录中的定义编号，-1表示不在目录中
+    bool cost_modified=false;//花费是否已被reducecost改动，改动后紧凑格式需要带上cost
+    protocol::CostResource cost_resource=protocol::CostResource::unknown;//cost中第一项的资源，构造时解析一次
+
+    // 已编码的卡牌片段缓存，按[编码][是否紧凑]存放，HP、编号、状态或花费变化时整体失效
+    // 卡牌只在所属房间的strand上读写，缓存不需要加锁
+    mutable std::string fragments[3][2];
+    mutable uint8_t fragment_valid=0;
+
+    void invalidate(){
+        fragment_valid=0;
+    }
 public:
     Card(std::string name,int HP,int ATK,std::vector<std::string> property,std::unordered_multimap<std::string,int> cost,std::string race)
     :name(name),HP(HP),ATK(ATK),property(property),cost(cost),race(race)
     { 
-
+        if(!this->cost.empty()) cost_resource=protocol::cost_resource(this->cost.begin()->first);
     }
 
     // 添加复制构造函数
@@ -48,7 +65,10 @@ public:
         property(other.property),
         cost(other.cost),
         race(other.race),
-        card_id(0)  // 注意：这里重置 card_id 为 0，不复制原来的 ID
+        card_id(0),  // 注意：这里重置 card_id 为 0，不复制原来的 ID
+        def_id(other.def_id),
+        cost_modified(other.cost_modified),
+        cost_resource(other.cost_resource)
     {}
     
     // 添加赋值运算符
@@ -61,6 +81,10 @@ public:
             cost = other.cost;
             race = other.race;
             card_id = 0;  // 重置 ID
+            def_id = other.def_id;
+            cost_modified = other.cost_modified;
+            cost_resource = other.cost_resource;
+            invalidate();
         }
         return *this;
     }
@@ -85,6 +109,37 @@ public:
         cardJson["card_id"] = card_id;
         
         // 将 cost multimap 转换为 JSON 数组
+        cardJson["cost"] = costJson();
+        
+        return cardJson;
+    }
+
+    // 紧凑格式：只带目录定义编号和会变化的字段，名字、属性、种族从card_catalog中查
+    // 不在目录中的卡牌退回完整格式
+    nlohmann::json toCompactJson() const {
+        if (def_id < 0) return toJson();
+        nlohmann::json cardJson;
+        cardJson["def"] = def_id;
+        cardJson["HP"] = HP;
+        cardJson["ATK"] = ATK;
+        cardJson["card_id"] = card_id;
+        if (cost_modified) cardJson["cost"] = costJson();
+        return cardJson;
+    }
+
+    // 按连接编码缓存的toJson()/toCompactJson()结果，供下行消息直接拼接
+    const std::string& fragment(WireCodec codec, bool compact) const {
+        int c = static_cast<int>(codec);
+        uint8_t bit = static_cast<uint8_t>(1u << (c * 2 + (compact ? 1 : 0)));
+        std::string& cached = fragments[c][compact ? 1 : 0];
+        if (!(fragment_valid & bit)) {
+            cached = wire::encode(codec, compact ? toCompactJson() : toJson());
+            fragment_valid |= bit;
+        }
+        return cached;
+    }
+
+    nlohmann::json costJson() const {
         nlohmann::json costArray = nlohmann::json::array();
         for (const auto& [resource, amount] : cost) {
             nlohmann::json costItem;
@@ -92,13 +147,20 @@ public:
             costItem["amount"] = amount;
             costArray.push_back(costItem);
         }
-        cardJson["cost"] = costArray;
-        
-        return cardJson;
+        return costArray;
+    }
+
+    void set_def_id(int def_id){
+        this->def_id = def_id;
+        invalidate();
+    }
+    int get_def_id() const{
+        return def_id;
     }
 
     void set_card_state(int card_state){
         this->card_state = card_state;
+        invalidate();
     }
 
     int get_card_state(){
@@ -117,18 +179,25 @@ public:
     const std::unordered_multimap<std::string,int> &getcost() {
         return cost;
     }
+    protocol::CostResource get_cost_resource() const {
+        return cost_resource;
+    }
     void reducecost(int cost_reduce) {
         for (auto& [resource, amount] : cost) {
             amount -= cost_reduce;
         }
+        cost_modified = true;
+        invalidate();
     }
 
 
     void lossHP(int HPs) { 
         this->HP = HP-HPs;
+        invalidate();
     }
     void addHP(int HPs) { 
         this->HP = HP+HPs;
+        invalidate();
     }
     int getHP() const{
         return HP;
@@ -139,11 +208,37 @@ public:
     }
     void set_play_current_card_id(int play_current_card_id){
         this->card_id = play_current_card_id;
+        invalidate();
     }
 
-    int get_play_current_card_id(){
+    int get_play_current_card_id() const{
         return this->card_id;
     }
+
+    // 热重启转存：目录定义编号加上对局中会变化的字段，由CardRandomizer::restoreCard按定义重建
+    nlohmann::json saveState() const {
+        nlohmann::json state;
+        state["def"] = def_id;
+        state["HP"] = HP;
+        state["card_id"] = card_id;
+        state["state"] = card_state;
+        if (cost_modified) state["cost"] = costJson();
+        return state;
+    }
+
+    void restoreState(const nlohmann::json& state) {
+        HP = state.at("HP").get<int>();
+        card_id = state.at("card_id").get<int>();
+        card_state = state.at("state").get<int>();
+        if (state.contains("cost")) {
+            cost.clear();
+            for (const auto& item : state["cost"]) {
+                cost.emplace(item.at("resource").get<std::string>(), item.at("amount").get<int>());
+            }
+            cost_modified = true;
+        }
+        invalidate();
+    }
 };
 
 class Cardfactory{
@@ -274,22 +369,66 @@ protected:
 };
 
 
-class CardRandomizer {
+// 卡牌原型目录：所有卡牌定义只创建一次，之后只读
+// 多进程部署时在fork之前构建，各工作进程通过写时复制共享同一份只读内存
+class CardCatalog {
 private:
     std::vector<std::unique_ptr<Card>> cardCollection;
-   
     std::unique_ptr<Card> squirrelCard;
-    std::random_device rd;
-    std::mt19937 gen;
-    int iniflags = 0;
-    
-public:
-    CardRandomizer() : gen(rd()) {
+
+    nlohmann::json catalogJson;
+    std::string catalogVersion;
+
+    CardCatalog() {
         // 创建所有卡牌并存储
         initializeCardCollection();
         initializesquirrelCard();
+        buildCatalogJson();
+    }
+
+    // 定义编号按目录顺序分配，松鼠排在最后；版本号为定义内容的FNV-1a哈希，定义不变则版本不变
+    void buildCatalogJson() {
+        nlohmann::json definitions = nlohmann::json::array();
+        int def_id = 0;
+        auto add = [&](Card& card) {
+            card.set_def_id(def_id++);
+            nlohmann::json definition = card.toJson();
+            definition.erase("card_id");
+            definition["def"] = card.get_def_id();
+            definitions.push_back(definition);
+        };
+        for (auto& card : cardCollection) add(*card);
+        add(*squirrelCard);
+
+        uint64_t hash = 1469598103934665603ULL;
+        for (unsigned char c : definitions.dump()) {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        char version[17];
+        snprintf(version, sizeof(version), "%016llx", static_cast<unsigned long long>(hash));
+        catalogVersion = version;
+
+        catalogJson["type"] = "card_catalog";
+        catalogJson["version"] = catalogVersion;
+        catalogJson["cards"] = definitions;
     }
-    
+
+public:
+    static const CardCatalog& shared() {
+        static const CardCatalog catalog;
+        return catalog;
+    }
+
+    // 完整的卡牌定义列表 {"type":"card_catalog","version":...,"cards":[...]}
+    const nlohmann::json& toJson() const {
+        return catalogJson;
+    }
+
+    const std::string& version() const {
+        return catalogVersion;
+    }
+
     void initializesquirrelCard(){
         auto methodsquirrelFactory = std::make_unique<squirrel>();
         squirrelCard=methodsquirrelFactory->createCardwithsetup("松鼠",1,0,{},{}, "松鼠");
@@ -336,9 +475,43 @@ public:
             methodUnclassifiedFactory->createCardwithsetup("箭毒蛙",3,0,{"尖刺铠甲1","死神之触"},{{"血滴",2}}, "无类别")
         );
     }
+
+    const std::vector<std::unique_ptr<Card>>& cards() const {
+        return cardCollection;
+    }
+
+    const Card& squirrelPrototype() const {
+        return *squirrelCard;
+    }
+};
+
+// 对局种子：房间的所有随机数都由一个64位种子派生，不同用途取不同的stream（splitmix64），记下种子即可复现整局
+inline uint64_t derive_seed(uint64_t seed, uint64_t stream) {
+    uint64_t z = seed + 0x9e3779b97f4a7c15ull * (stream + 1);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+inline std::mt19937 seeded_engine(uint64_t seed) {
+    std::seed_seq sequence{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)};
+    return std::mt19937(sequence);
+}
+
+// 每个房间一个抽牌器：只持有随机数状态和卡牌编号计数，卡牌原型来自共享的CardCatalog
+class CardRandomizer {
+private:
+    const CardCatalog& catalog;
+    std::mt19937 gen;
+    int iniflags = 0;
+    
+public:
+    explicit CardRandomizer(uint64_t seed) : catalog(CardCatalog::shared()), gen(seeded_engine(seed)) {
+    }
     
     // 随机获取卡牌（返回指针，不转移所有权）
     Card* getRandomCard() {
+        const auto& cardCollection = catalog.cards();
         if (cardCollection.empty()) {
             return nullptr;
         }
@@ -353,7 +526,7 @@ public:
 
     // 按名获取卡牌
     Card* getcard(std::string name){
-        for(auto &card:cardCollection)
+        for(auto &card:catalog.cards())
         {
             if(card->getName()==name)
             {
@@ -363,15 +536,45 @@ public:
                 return card1;
             }
         }
+        return nullptr;
     }
 
     //获取松鼠牌
     Card* getsquirrel(){
-        Card* card1=new Card(*squirrelCard);
+        Card* card1=new Card(catalog.squirrelPrototype());
         card1->set_play_current_card_id(iniflags++);
         return card1;
     }
 
+    // 按Card::saveState()的内容重建卡牌，定义编号不在目录中时返回nullptr
+    Card* restoreCard(const nlohmann::json& state) {
+        int def = state.at("def").get<int>();
+        const auto& cardCollection = catalog.cards();
+        const Card* prototype = nullptr;
+        if (def >= 0 && def < static_cast<int>(cardCollection.size())) {
+            prototype = cardCollection[def].get();
+        } else if (def == catalog.squirrelPrototype().get_def_id()) {
+            prototype = &catalog.squirrelPrototype();
+        }
+        if (!prototype) return nullptr;
+        Card* card = new Card(*prototype);
+        card->restoreState(state);
+        return card;
+    }
+
+    // 随机数状态和下一个卡牌编号，热重启后继续同一序列
+    nlohmann::json saveState() const {
+        std::ostringstream rng;
+        rng << gen;
+        return {{"next_card_id", iniflags}, {"rng", rng.str()}};
+    }
+
+    void restoreState(const nlohmann::json& state) {
+        iniflags = state.at("next_card_id").get<int>();
+        std::istringstream rng(state.at("rng").get<std::string>());
+        rng >> gen;
+    }
+
     // 获取鸽子牌
     // Card* getskip(std::string name){
     //     // 创建一个 Unclassified 工厂
@@ -388,7 +591,7 @@ public:
     
     // 打印所有卡牌
     void printAllCards() const {
-        for (const auto& card : cardCollection) {
+        for (const auto& card : catalog.cards()) {
             std::cout << "卡牌: " << card->getName() << std::endl;
             std::cout << "属性:";
             for(auto i:card->getproperty()){
@@ -0,0 +1,71 @@
+#ifndef CONCURRENT_QUEUE_HPP
+#define CONCURRENT_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// 缓存行大小，用于把不同线程频繁写的字段隔开
+constexpr std::size_t kCacheLineSize = 64;
+
+// 多生产者单消费者无锁队列（Vyukov链表队列）
+// push可在任意线程调用，只有一次原子交换；pop只能由唯一的消费者线程调用
+// T需要可默认构造（哨兵节点使用）
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() {
+        Node* stub = new Node();
+        head_.store(stub, std::memory_order_relaxed);
+        tail_ = stub;
+    }
+
+    ~MpscQueue() {
+        T discarded;
+        while (pop(discarded)) {
+        }
+        delete tail_;
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T value) {
+        Node* node = new Node();
+        node->value = std::move(value);
+        size_.fetch_add(1, std::memory_order_relaxed);
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    bool pop(T& out) {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return false;
+        }
+        out = std::move(next->value);
+        tail_ = next;
+        delete tail;
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // 近似长度，仅用于统计
+    int64_t size_approx() const {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        T value{};
+    };
+
+    alignas(kCacheLineSize) std::atomic<Node*> head_;
+    alignas(kCacheLineSize) Node* tail_;
+    alignas(kCacheLineSize) std::atomic<int64_t> size_{0};
+};
+
+#endif
@@ -0,0 +1,275 @@
+#ifndef DEFLATE_HPP
+#define DEFLATE_HPP
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <websocketpp/extensions/permessage_deflate/enabled.hpp>
+
+// 按消息类型统计压缩效果：压缩前后字节数和压缩耗时
+// 压缩在con->send内部、调用send的线程上同步完成，FrameSender在send前用Scope标记当前消息类型
+class CompressionStats {
+public:
+    struct Entry {
+        std::atomic<uint64_t> messages{0};
+        std::atomic<uint64_t> bytes_in{0};
+        std::atomic<uint64_t> bytes_out{0};
+        std::atomic<uint64_t> nanos{0};
+    };
+
+    struct Snapshot {
+        std::string type;
+        uint64_t messages = 0;
+        uint64_t bytes_in = 0;
+        uint64_t bytes_out = 0;
+        uint64_t nanos = 0;
+
+        double ratio() const { return bytes_in ? static_cast<double>(bytes_out) / bytes_in : 1.0; }
+    };
+
+    class Scope {
+    public:
+        explicit Scope(Entry* entry) : prev_(current()) { current() = entry; }
+        ~Scope() { current() = prev_; }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Entry* prev_;
+    };
+
+    // 每线程缓存类型到统计项的映射，只有第一次遇到某类型时才加全局锁
+    static Entry& entry(const std::string& type) {
+        thread_local std::unordered_map<std::string, Entry*> cache;
+        auto it = cache.find(type);
+        if (it != cache.end()) return *it->second;
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        auto& slot = reg.entries[type];
+        if (!slot) slot = std::make_unique<Entry>();
+        cache.emplace(type, slot.get());
+        return *slot;
+    }
+
+    static Entry*& current() {
+        thread_local Entry* entry = nullptr;
+        return entry;
+    }
+
+    static void record(size_t in, size_t out, std::chrono::nanoseconds elapsed) {
+        Entry* e = current();
+        if (!e) e = &entry("other");
+        e->messages.fetch_add(1, std::memory_order_relaxed);
+        e->bytes_in.fetch_add(in, std::memory_order_relaxed);
+        e->bytes_out.fetch_add(out, std::memory_order_relaxed);
+        e->nanos.fetch_add(static_cast<uint64_t>(elapsed.count()), std::memory_order_relaxed);
+    }
+
+    static std::vector<Snapshot> snapshot() {
+        std::vector<Snapshot> out;
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (const auto& [type, e] : reg.entries) {
+            Snapshot s;
+            s.type = type;
+            s.messages = e->messages.load(std::memory_order_relaxed);
+            s.bytes_in = e->bytes_in.load(std::memory_order_relaxed);
+            s.bytes_out = e->bytes_out.load(std::memory_order_relaxed);
+            s.nanos = e->nanos.load(std::memory_order_relaxed);
+            if (s.messages) out.push_back(std::move(s));
+        }
+        return out;
+    }
+
+    // 单行汇总：类型=压缩率/每条平均耗时(us)
+    static std::string summary() {
+        std::string line;
+        for (const auto& s : snapshot()) {
+            char buf[128];
+            snprintf(buf, sizeof(buf), " %s=%.2f/%.1fus", s.type.c_str(), s.ratio(),
+                     s.nanos / 1000.0 / s.messages);
+            line += buf;
+        }
+        return line;
+    }
+
+private:
+    struct Registry {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::unique_ptr<Entry>> entries;
+    };
+
+    static Registry& registry() {
+        static Registry reg;
+        return reg;
+    }
+};
+
+// permessage-deflate（RFC 7692）扩展，替换websocketpp自带的实现：
+// 自带实现把memLevel固定为4且压缩级别不可调，这里窗口位数、memLevel和压缩级别都由settings()决定
+// 按websocketpp的扩展接口实现（is_implemented/negotiate/init/compress/decompress），作为game_config的permessage_deflate_type
+// 是否压缩某条消息由发送方设置message的compressed标志决定，小于min_size的消息不压缩
+class TunedDeflate {
+public:
+    struct Settings {
+        bool enabled = true;
+        int window_bits = 15;                // 服务器压缩窗口，9-15
+        int mem_level = 8;                   // zlib memLevel，1-9
+        int level = Z_DEFAULT_COMPRESSION;   // zlib压缩级别，-1或0-9
+        size_t min_size = 256;               // 小于该字节数的消息不压缩
+    };
+
+    static Settings& settings() {
+        static Settings settings;
+        return settings;
+    }
+
+    TunedDeflate() = default;
+
+    ~TunedDeflate() {
+        if (!initialized_) return;
+        deflateEnd(&dstate_);
+        inflateEnd(&istate_);
+    }
+
+    TunedDeflate(const TunedDeflate&) = delete;
+    TunedDeflate& operator=(const TunedDeflate&) = delete;
+
+    // 关闭压缩时websocketpp不会处理握手中的扩展请求
+    bool is_implemented() const { return settings().enabled; }
+
+    bool is_enabled() const { return enabled_; }
+
+    websocketpp::extensions::err_str_pair negotiate(const websocketpp::http::attribute_list& offer) {
+        namespace pmd_error = websocketpp::extensions::permessage_deflate::error;
+        websocketpp::extensions::err_str_pair ret;
+        int window_bits = std::min(15, std::max(9, settings().window_bits));
+        bool client_no_context_takeover = false;
+
+        for (const auto& [name, value] : offer) {
+            if (name == "server_no_context_takeover") {
+                server_no_context_takeover_ = true;
+            } else if (name == "client_no_context_takeover") {
+                client_no_context_takeover = true;
+            } else if (name == "server_max_window_bits") {
+                int requested = value.empty() ? 0 : std::atoi(value.c_str());
+                // zlib的raw deflate不支持8位窗口，客户端要求更小的窗口时拒绝该提议
+                if (requested < 9 || requested > 15) {
+                    ret.first = pmd_error::make_error_code(pmd_error::invalid_max_window_bits);
+                    return ret;
+                }
+                window_bits = std::min(window_bits, requested);
+            } else if (name == "client_max_window_bits") {
+                // 解压按15位窗口进行，接受客户端任意窗口，不在响应中限制
+            } else {
+                ret.first = pmd_error::make_error_code(pmd_error::unsupported_attributes);
+                return ret;
+            }
+        }
+
+        window_bits_ = window_bits;
+        ret.second = "permessage-deflate";
+        if (server_no_context_takeover_) ret.second += "; server_no_context_takeover";
+        if (client_no_context_takeover) ret.second += "; client_no_context_takeover";
+        if (window_bits_ < 15) ret.second += "; server_max_window_bits=" + std::to_string(window_bits_);
+        enabled_ = true;
+        return ret;
+    }
+
+    websocketpp::lib::error_code init(bool /*is_server*/) {
+        namespace pmd_error = websocketpp::extensions::permessage_deflate::error;
+        const Settings& s = settings();
+        dstate_.zalloc = Z_NULL;
+        dstate_.zfree = Z_NULL;
+        dstate_.opaque = Z_NULL;
+        istate_.zalloc = Z_NULL;
+        istate_.zfree = Z_NULL;
+        istate_.opaque = Z_NULL;
+        istate_.avail_in = 0;
+        istate_.next_in = Z_NULL;
+
+        int mem_level = std::min(9, std::max(1, s.mem_level));
+        if (deflateInit2(&dstate_, s.level, Z_DEFLATED, -window_bits_, mem_level, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return pmd_error::make_error_code(pmd_error::zlib_error);
+        }
+        if (inflateInit2(&istate_, -15) != Z_OK) {
+            deflateEnd(&dstate_);
+            return pmd_error::make_error_code(pmd_error::zlib_error);
+        }
+        buffer_.reset(new unsigned char[kBufferSize]);
+        initialized_ = true;
+        return websocketpp::lib::error_code();
+    }
+
+    // 按RFC 7692第7.2.1节以Z_SYNC_FLUSH结束并去掉末尾的00 00 ff ff
+    websocketpp::lib::error_code compress(const std::string& in, std::string& out) {
+        namespace pmd_error = websocketpp::extensions::permessage_deflate::error;
+        if (!initialized_) {
+            return pmd_error::make_error_code(pmd_error::uninitialized);
+        }
+        auto start = std::chrono::steady_clock::now();
+        size_t offset = out.size();
+        if (in.empty()) {
+            out.push_back(0x00);
+        } else {
+            dstate_.avail_in = static_cast<uInt>(in.size());
+            dstate_.next_in = reinterpret_cast<unsigned char*>(const_cast<char*>(in.data()));
+            do {
+                dstate_.avail_out = kBufferSize;
+                dstate_.next_out = buffer_.get();
+                deflate(&dstate_, Z_SYNC_FLUSH);
+                out.append(reinterpret_cast<char*>(buffer_.get()), kBufferSize - dstate_.avail_out);
+            } while (dstate_.avail_out == 0);
+
+            if (out.size() - offset >= 4 && out.compare(out.size() - 4, 4, std::string("\x00\x00\xff\xff", 4)) == 0) {
+                out.resize(out.size() - 4);
+            }
+            if (server_no_context_takeover_) {
+                deflateReset(&dstate_);
+            }
+        }
+        CompressionStats::record(in.size(), out.size() - offset, std::chrono::steady_clock::now() - start);
+        return websocketpp::lib::error_code();
+    }
+
+    websocketpp::lib::error_code decompress(const uint8_t* buf, size_t len, std::string& out) {
+        namespace pmd_error = websocketpp::extensions::permessage_deflate::error;
+        if (!initialized_) {
+            return pmd_error::make_error_code(pmd_error::uninitialized);
+        }
+        istate_.avail_in = static_cast<uInt>(len);
+        istate_.next_in = const_cast<unsigned char*>(buf);
+        do {
+            istate_.avail_out = kBufferSize;
+            istate_.next_out = buffer_.get();
+            int ret = inflate(&istate_, Z_SYNC_FLUSH);
+            if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR) {
+                return pmd_error::make_error_code(pmd_error::zlib_error);
+            }
+            out.append(reinterpret_cast<char*>(buffer_.get()), kBufferSize - istate_.avail_out);
+        } while (istate_.avail_out == 0);
+        return websocketpp::lib::error_code();
+    }
+
+private:
+    static constexpr uInt kBufferSize = 16384;
+
+    bool enabled_ = false;
+    bool initialized_ = false;
+    bool server_no_context_takeover_ = false;
+    int window_bits_ = 15;
+    z_stream dstate_{};
+    z_stream istate_{};
+    std::unique_ptr<unsigned char[]> buffer_;
+};
+
+#endif
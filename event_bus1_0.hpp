@@ -0,0 +1,277 @@
+#ifndef EVENT_BUS_HPP
+#define EVENT_BUS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "concurrent_queue1_0.hpp"
+#include "logger1_0.hpp"
+
+// 进程内的游戏事件总线：房间在自己的strand上发布事件，录像、统计、观战等订阅方各自消费
+//  - 每种事件一个主题，订阅列表写时复制；发布时只用一次acquire读取当前列表的裸指针，不加锁、不改引用计数。
+//    旧列表在订阅、退订时不释放，保留到主题销毁（订阅和退订只在启动或关闭时发生，次数很少）
+//  - 每个订阅方有独立的有界队列和投递线程，队列满时丢弃新事件并计数，慢订阅方不会拖慢房间
+//  - 投递线程没有事件时在条件变量上睡眠；发布方入队不加锁，只有投递线程正在睡眠时才加锁唤醒一次
+//  - 没有订阅方时发布只有一次原子读取，房间可以先用wants()判断再构建事件
+
+// 玩家提交一回合的出牌
+struct MoveEvent {
+    std::string room;
+    std::string player;
+    std::vector<std::string> played;   // 场上各栏位的卡牌名，按栏位顺序
+    size_t hand_size = 0;              // 出牌后剩余手牌数
+    int bones = 0;                     // 出牌后剩余骨头数
+};
+
+// 卡牌在战斗中死亡或被献祭
+struct DeathEvent {
+    std::string room;
+    std::string owner;                 // 卡牌所属玩家
+    std::string card;
+    int card_id = 0;
+    int slot = 0;
+};
+
+// 玩家获得骨头（己方卡牌死亡或被献祭）
+struct BoneGainEvent {
+    std::string room;
+    std::string player;
+    int gained = 0;
+    int total = 0;
+};
+
+// 对局结束
+struct GameEndEvent {
+    std::string room;
+    std::string winner;
+    std::string loser;
+    int player_hp = 0;                 // 结束时的血量标尺，见play::cur_plays
+};
+
+// 订阅句柄：cancel或销毁后不再收到事件，已入队但未投递的事件被丢弃
+class EventSubscription {
+public:
+    struct Stats {
+        std::string name;
+        uint64_t delivered = 0;
+        uint64_t dropped = 0;
+        int64_t backlog = 0;
+    };
+
+    virtual ~EventSubscription() = default;
+    virtual void cancel() = 0;
+    virtual Stats stats() const = 0;
+};
+
+template <typename Event>
+class EventTopic {
+public:
+    using Handler = std::function<void(const Event&)>;
+
+    class Subscriber : public EventSubscription {
+    public:
+        Subscriber(EventTopic& topic, std::string name, Handler handler, size_t capacity)
+            : topic_(topic), name_(std::move(name)), handler_(std::move(handler)), capacity_(capacity) {
+            worker_ = std::thread([this]() { run(); });
+        }
+
+        ~Subscriber() override { stop(); }
+
+        void cancel() override {
+            topic_.remove(this);
+            stop();
+        }
+
+        Stats stats() const override {
+            Stats stats;
+            stats.name = name_;
+            stats.delivered = delivered_.load(std::memory_order_relaxed);
+            stats.dropped = dropped_.load(std::memory_order_relaxed);
+            stats.backlog = queue_.size_approx();
+            return stats;
+        }
+
+        void offer(const std::shared_ptr<const Event>& event) {
+            if (!running_.load(std::memory_order_relaxed)) return;
+            if (queue_.size_approx() >= static_cast<int64_t>(capacity_)) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            queue_.push(event);
+            // 与run()中的栅栏配对：要么投递线程看到新事件，要么这里看到它已睡眠
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleeping_.load(std::memory_order_relaxed) && sleeping_.exchange(false)) {
+                std::lock_guard<std::mutex> lock(wake_mutex_);
+                wake_.notify_one();
+            }
+        }
+
+    private:
+        // 兜底的最长睡眠时间，正常情况下由offer()唤醒
+        static constexpr auto kMaxIdleWait = std::chrono::milliseconds(100);
+
+        void run() {
+            std::shared_ptr<const Event> event;
+            while (running_.load(std::memory_order_acquire)) {
+                while (queue_.pop(event)) {
+                    try {
+                        handler_(*event);
+                    } catch (const std::exception& e) {
+                        LOG_ERROR("event subscriber failed", {{"subscriber", name_}, {"error", e.what()}});
+                    }
+                    delivered_.fetch_add(1, std::memory_order_relaxed);
+                    event.reset();
+                }
+                std::unique_lock<std::mutex> lock(wake_mutex_);
+                sleeping_.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (queue_.size_approx() > 0 || !running_.load(std::memory_order_acquire)) {
+                    sleeping_.store(false, std::memory_order_relaxed);
+                    continue;
+                }
+                wake_.wait_for(lock, kMaxIdleWait, [this]() { return !sleeping_.load(std::memory_order_relaxed); });
+                sleeping_.store(false, std::memory_order_relaxed);
+            }
+        }
+
+        void stop() {
+            running_.store(false, std::memory_order_release);
+            {
+                std::lock_guard<std::mutex> lock(wake_mutex_);
+                sleeping_.store(false, std::memory_order_relaxed);
+                wake_.notify_one();
+            }
+            if (worker_.joinable() && worker_.get_id() != std::this_thread::get_id()) {
+                worker_.join();
+            }
+        }
+
+        EventTopic& topic_;
+        std::string name_;
+        Handler handler_;
+        size_t capacity_;
+        MpscQueue<std::shared_ptr<const Event>> queue_;
+        std::atomic<bool> running_{true};
+        std::atomic<uint64_t> delivered_{0};
+        std::atomic<uint64_t> dropped_{0};
+        std::atomic<bool> sleeping_{false};
+        std::mutex wake_mutex_;
+        std::condition_variable wake_;
+        std::thread worker_;
+    };
+
+    // 交给订阅方的句柄，销毁时自动退订
+    class Handle : public EventSubscription {
+    public:
+        explicit Handle(std::shared_ptr<Subscriber> subscriber) : subscriber_(std::move(subscriber)) {}
+        ~Handle() override { cancel(); }
+        void cancel() override { subscriber_->cancel(); }
+        Stats stats() const override { return subscriber_->stats(); }
+
+    private:
+        std::shared_ptr<Subscriber> subscriber_;
+    };
+
+    using List = std::vector<std::shared_ptr<Subscriber>>;
+
+    EventTopic() {
+        lists_.push_back(std::make_unique<const List>());
+        current_.store(lists_.back().get(), std::memory_order_release);
+    }
+
+    EventTopic(const EventTopic&) = delete;
+    EventTopic& operator=(const EventTopic&) = delete;
+
+    std::shared_ptr<EventSubscription> subscribe(std::string name, Handler handler, size_t capacity) {
+        auto subscriber = std::make_shared<Subscriber>(*this, std::move(name), std::move(handler), capacity);
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        auto next = std::make_unique<List>(*current_.load(std::memory_order_relaxed));
+        next->push_back(subscriber);
+        install(std::move(next));
+        return std::make_shared<Handle>(std::move(subscriber));
+    }
+
+    bool has_subscribers() const { return !current_.load(std::memory_order_acquire)->empty(); }
+
+    void publish(Event event) {
+        const List* list = current_.load(std::memory_order_acquire);
+        if (list->empty()) return;
+        auto shared = std::make_shared<const Event>(std::move(event));
+        for (const auto& subscriber : *list) {
+            subscriber->offer(shared);
+        }
+    }
+
+    void collect_stats(std::vector<EventSubscription::Stats>& out) const {
+        for (const auto& subscriber : *current_.load(std::memory_order_acquire)) {
+            out.push_back(subscriber->stats());
+        }
+    }
+
+private:
+    void remove(Subscriber* subscriber) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        auto next = std::make_unique<List>();
+        for (const auto& s : *current_.load(std::memory_order_relaxed)) {
+            if (s.get() != subscriber) next->push_back(s);
+        }
+        install(std::move(next));
+    }
+
+    // 调用方持有write_mutex_。发布方可能仍在遍历旧列表，旧列表（连同其中已停止的订阅方）保留到主题销毁
+    void install(std::unique_ptr<List> next) {
+        lists_.push_back(std::move(next));
+        current_.store(lists_.back().get(), std::memory_order_release);
+    }
+
+    std::atomic<const List*> current_{nullptr};
+    std::vector<std::unique_ptr<const List>> lists_; // 所有发布过的列表，由write_mutex_保护
+    std::mutex write_mutex_; // 只串行化订阅和退订
+};
+
+// 按事件类型选择主题；总线需要比所有订阅句柄活得久
+class EventBus {
+public:
+    static constexpr size_t kDefaultCapacity = 1024;
+
+    template <typename Event>
+    std::shared_ptr<EventSubscription> subscribe(std::string name, typename EventTopic<Event>::Handler handler,
+                                                 size_t capacity = kDefaultCapacity) {
+        return topic<Event>().subscribe(std::move(name), std::move(handler), capacity);
+    }
+
+    template <typename Event>
+    void publish(Event event) {
+        topic<Event>().publish(std::move(event));
+    }
+
+    template <typename Event>
+    bool wants() const {
+        return std::get<EventTopic<Event>>(topics_).has_subscribers();
+    }
+
+    std::vector<EventSubscription::Stats> stats() const {
+        std::vector<EventSubscription::Stats> out;
+        std::apply([&out](const auto&... topic) { (topic.collect_stats(out), ...); }, topics_);
+        return out;
+    }
+
+private:
+    template <typename Event>
+    EventTopic<Event>& topic() {
+        return std::get<EventTopic<Event>>(topics_);
+    }
+
+    std::tuple<EventTopic<MoveEvent>, EventTopic<DeathEvent>, EventTopic<BoneGainEvent>, EventTopic<GameEndEvent>>
+        topics_;
+};
+
+#endif
@@ -0,0 +1,315 @@
+#ifndef INBOUND_HPP
+#define INBOUND_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "wire_codec1_0.hpp"
+#include "protocol1_0.hpp"
+
+// 上行消息中服务器用到的全部字段，由SAX解析直接填入，不构建json DOM
+// 未识别的字段跳过；已识别字段类型不对时整帧视为格式错误
+struct InboundMessage {
+    struct Cost {
+        std::string resource;
+        protocol::CostResource resource_id = protocol::CostResource::unknown;
+        int amount = 0;
+    };
+
+    std::string type;
+    protocol::MessageType type_id = protocol::MessageType::unknown;
+
+    // player_join
+    std::string player_id;
+    std::string room_id;
+    std::string catalog_version;
+    std::string reconnect_token;
+    std::optional<uint64_t> last_seq;
+    bool batch = false;
+    bool delta = false;
+    bool compact_cards = false;
+
+    // board_ack
+    std::optional<uint64_t> seq;
+
+    // special_action
+    std::string action_type;
+    protocol::DrawKind draw = protocol::DrawKind::unknown;
+
+    // card_placement_update：action为"add"或"clear"，card.card_id和card.cost
+    std::string action;
+    protocol::PlacementAction placement = protocol::PlacementAction::unknown;
+    int card_id = 0;
+    std::vector<Cost> card_cost;
+
+    // player_action：每个栏位中出的卡牌编号（slots[i][j].id）
+    std::vector<std::vector<int>> slots;
+
+    // 解析上限，超出时在解析过程中直接中止，不再分配内存
+    static constexpr size_t kMaxDepth = 6;
+    static constexpr size_t kMaxString = 256;
+    static constexpr size_t kMaxSlots = 4;
+    static constexpr size_t kMaxCardsPerSlot = 8;
+    static constexpr size_t kMaxCosts = 8;
+
+    // 按连接编码解析一帧；格式错误、超出上限或缺少type时返回false，error说明原因
+    static bool parse(WireCodec codec, const std::string& payload, InboundMessage& out, std::string& error);
+
+    // 还原为只含上述字段的JSON上行消息，按json编码重新parse得到相同的内容；用于命令日志
+    nlohmann::json to_json() const;
+};
+
+namespace inbound_detail {
+
+class Sax : public nlohmann::json_sax<nlohmann::json> {
+public:
+    explicit Sax(InboundMessage& msg) : msg_(msg) {}
+
+    const std::string& error() const { return error_; }
+
+    bool null() override { return scalar_skipped(); }
+
+    bool boolean(bool val) override {
+        if (top() != Ctx::root) return scalar_skipped();
+        if (key_ == "batch") msg_.batch = val;
+        else if (key_ == "delta") msg_.delta = val;
+        else if (key_ == "compact_cards") msg_.compact_cards = val;
+        return true;
+    }
+
+    bool number_integer(number_integer_t val) override {
+        if (val < 0) return integer(val, std::nullopt);
+        return integer(val, static_cast<uint64_t>(val));
+    }
+
+    bool number_unsigned(number_unsigned_t val) override {
+        return integer(val <= static_cast<uint64_t>(INT64_MAX) ? static_cast<int64_t>(val) : INT64_MAX, val);
+    }
+
+    bool number_float(number_float_t, const string_t&) override {
+        if (expects_integer()) return fail("field " + key_ + " must be an integer");
+        return true;
+    }
+
+    bool string(string_t& val) override {
+        if (val.size() > InboundMessage::kMaxString) return fail("string field too long");
+        switch (top()) {
+        case Ctx::root:
+            if (key_ == "type") {
+                msg_.type_id = protocol::message_type(val);
+                msg_.type = std::move(val);
+            } else if (key_ == "player_id") msg_.player_id = std::move(val);
+            else if (key_ == "room_id") msg_.room_id = std::move(val);
+            else if (key_ == "catalog_version") msg_.catalog_version = std::move(val);
+            else if (key_ == "reconnect_token") msg_.reconnect_token = std::move(val);
+            else if (key_ == "action_type") {
+                msg_.draw = protocol::draw_kind(val);
+                msg_.action_type = std::move(val);
+            } else if (key_ == "action") {
+                msg_.placement = protocol::placement_action(val);
+                msg_.action = std::move(val);
+            } else if (expects_integer()) return fail("field " + key_ + " must be an integer");
+            return true;
+        case Ctx::cost_item:
+            if (key_ == "resource") {
+                msg_.card_cost.back().resource_id = protocol::cost_resource(val);
+                msg_.card_cost.back().resource = std::move(val);
+            }
+            else if (key_ == "amount") return fail("cost amount must be an integer");
+            return true;
+        default:
+            if (expects_integer()) return fail("field " + key_ + " must be an integer");
+            return true;
+        }
+    }
+
+    bool binary(binary_t&) override { return scalar_skipped(); }
+
+    bool start_object(std::size_t) override {
+        Ctx parent = top();
+        Ctx next = Ctx::skip;
+        if (stack_.empty()) {
+            next = Ctx::root;
+        } else if (parent == Ctx::root && key_ == "card") {
+            next = Ctx::card;
+        } else if (parent == Ctx::cost_list) {
+            if (msg_.card_cost.size() >= InboundMessage::kMaxCosts) return fail("too many cost entries");
+            msg_.card_cost.emplace_back();
+            next = Ctx::cost_item;
+        } else if (parent == Ctx::slot) {
+            if (msg_.slots.back().size() >= InboundMessage::kMaxCardsPerSlot) return fail("too many cards in a slot");
+            next = Ctx::slot_card;
+        }
+        return push(next);
+    }
+
+    bool end_object() override { return pop(); }
+
+    bool start_array(std::size_t) override {
+        Ctx parent = top();
+        Ctx next = Ctx::skip;
+        if (stack_.empty()) {
+            return fail("message must be an object");
+        } else if (parent == Ctx::root && key_ == "slots") {
+            next = Ctx::slots;
+        } else if (parent == Ctx::card && key_ == "cost") {
+            next = Ctx::cost_list;
+        } else if (parent == Ctx::slots) {
+            if (msg_.slots.size() >= InboundMessage::kMaxSlots) return fail("too many slots");
+            msg_.slots.emplace_back();
+            next = Ctx::slot;
+        }
+        return push(next);
+    }
+
+    bool end_array() override { return pop(); }
+
+    bool key(string_t& val) override {
+        if (val.size() > InboundMessage::kMaxString) return fail("key too long");
+        key_ = std::move(val);
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& ex) override {
+        error_ = "malformed frame at byte " + std::to_string(position) + ": " + ex.what();
+        return false;
+    }
+
+private:
+    enum class Ctx { root, card, cost_list, cost_item, slots, slot, slot_card, skip };
+
+    Ctx top() const { return stack_.empty() ? Ctx::skip : stack_.back(); }
+
+    bool push(Ctx ctx) {
+        if (stack_.size() >= InboundMessage::kMaxDepth) return fail("message nested too deeply");
+        stack_.push_back(ctx);
+        key_.clear();
+        return true;
+    }
+
+    bool pop() {
+        stack_.pop_back();
+        key_.clear();
+        return true;
+    }
+
+    bool fail(const std::string& reason) {
+        if (error_.empty()) error_ = reason;
+        return false;
+    }
+
+    // 需要整数的已识别字段收到其他类型的值
+    bool expects_integer() const {
+        switch (top()) {
+        case Ctx::root: return key_ == "last_seq" || key_ == "seq";
+        case Ctx::card: return key_ == "card_id";
+        case Ctx::cost_item: return key_ == "amount";
+        case Ctx::slot_card: return key_ == "id";
+        default: return false;
+        }
+    }
+
+    bool scalar_skipped() {
+        if (expects_integer()) return fail("field " + key_ + " must be an integer");
+        return true;
+    }
+
+    // value为有符号值（超出int64时截断，只影响范围检查），unsigned_value为非负时的原值
+    bool integer(int64_t value, std::optional<uint64_t> unsigned_value) {
+        bool fits_int = value >= INT32_MIN && value <= INT32_MAX;
+        switch (top()) {
+        case Ctx::root:
+            if (key_ == "last_seq" || key_ == "seq") {
+                if (!unsigned_value) return fail("field " + key_ + " must be unsigned");
+                (key_ == "seq" ? msg_.seq : msg_.last_seq) = *unsigned_value;
+            }
+            return true;
+        case Ctx::card:
+            if (key_ == "card_id") {
+                if (!fits_int) return fail("card_id out of range");
+                msg_.card_id = static_cast<int>(value);
+            }
+            return true;
+        case Ctx::cost_item:
+            if (key_ == "amount") {
+                if (!fits_int) return fail("cost amount out of range");
+                msg_.card_cost.back().amount = static_cast<int>(value);
+            }
+            return true;
+        case Ctx::slot_card:
+            if (key_ == "id") {
+                if (!fits_int) return fail("card id out of range");
+                msg_.slots.back().push_back(static_cast<int>(value));
+            }
+            return true;
+        default:
+            return true;
+        }
+    }
+
+    InboundMessage& msg_;
+    std::vector<Ctx> stack_;
+    std::string key_;
+    std::string error_;
+};
+
+} // namespace inbound_detail
+
+inline bool InboundMessage::parse(WireCodec codec, const std::string& payload, InboundMessage& out, std::string& error) {
+    inbound_detail::Sax sax(out);
+    nlohmann::json::input_format_t format = nlohmann::json::input_format_t::json;
+    if (codec == WireCodec::cbor) format = nlohmann::json::input_format_t::cbor;
+    else if (codec == WireCodec::msgpack) format = nlohmann::json::input_format_t::msgpack;
+
+    bool ok = false;
+    try {
+        ok = nlohmann::json::sax_parse(payload, &sax, format);
+    } catch (const nlohmann::json::exception& e) {
+        error = e.what();
+        return false;
+    }
+    if (!ok) {
+        error = sax.error().empty() ? "malformed frame" : sax.error();
+        return false;
+    }
+    if (out.type.empty()) {
+        error = "missing type";
+        return false;
+    }
+    return true;
+}
+
+inline nlohmann::json InboundMessage::to_json() const {
+    nlohmann::json out;
+    out["type"] = type;
+    if (!player_id.empty()) out["player_id"] = player_id;
+    if (!room_id.empty()) out["room_id"] = room_id;
+    if (!catalog_version.empty()) out["catalog_version"] = catalog_version;
+    if (!reconnect_token.empty()) out["reconnect_token"] = reconnect_token;
+    if (last_seq) out["last_seq"] = *last_seq;
+    if (batch) out["batch"] = true;
+    if (delta) out["delta"] = true;
+    if (compact_cards) out["compact_cards"] = true;
+    if (seq) out["seq"] = *seq;
+    if (!action_type.empty()) out["action_type"] = action_type;
+    if (!action.empty()) out["action"] = action;
+    if (card_id != 0 || !card_cost.empty()) {
+        nlohmann::json cost = nlohmann::json::array();
+        for (const auto& c : card_cost) cost.push_back({{"resource", c.resource}, {"amount", c.amount}});
+        out["card"] = {{"card_id", card_id}, {"cost", std::move(cost)}};
+    }
+    if (!slots.empty()) {
+        nlohmann::json all = nlohmann::json::array();
+        for (const auto& slot : slots) {
+            nlohmann::json cards = nlohmann::json::array();
+            for (int id : slot) cards.push_back({{"id", id}});
+            all.push_back(std::move(cards));
+        }
+        out["slots"] = std::move(all);
+    }
+    return out;
+}
+
+#endif
@@ -0,0 +1,342 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "concurrent_queue1_0.hpp"
+#include "logger1_0.hpp"
+#include "metrics1_0.hpp"
+
+// 房间命令日志（预写日志）：房间在strand上把已接受的命令和定期快照追加到日志，进程崩溃后按日志重建房间
+//  - 每条记录为 [长度u32][CRC32 u32][CBOR]，小端；读到长度或校验不符的记录即视为写了一半的尾部，之后的内容丢弃
+//  - 房间只把编码好的记录推入MPSC队列，不等待落盘；后台线程一次取出所有房间积压的记录，一次write、一次fdatasync
+//    （组提交），空闲时每commit_interval检查一次。崩溃最多丢失最近一个提交间隔加一次fdatasync时间内的命令
+//  - 日志分段存放，当前段超过segment_bytes后换新段并通过on_rotate通知上层，
+//    上层让所有房间在新段中各写一次快照后调用retire_before，旧段随之删除，重放时间因此有上界
+//  - 写入或fdatasync失败时把段截回最后一条完整记录之后，整批记录留在内存中每kRetryInterval重试；
+//    新段打不开时继续写当前段，同样按kRetryInterval重试换段
+class Journal {
+public:
+    static constexpr std::chrono::seconds kRetryInterval{1};
+
+    struct Options {
+        std::string dir = "journal";
+        uint64_t segment_bytes = 64ull << 20;
+        std::chrono::microseconds commit_interval{2000};
+        int snapshot_every = 64;            // 房间每执行这么多条命令写一次快照
+    };
+
+    struct Segment {
+        uint64_t number = 0;
+        std::string path;
+    };
+
+    // 目录不存在时创建；新段编号接在已有段之后，已有段留给上层读取重放，由retire_before删除
+    // on_rotate在换段后于后台线程上调用，参数为新段号；应当很短，通常只是把快照任务投递到各房间
+    explicit Journal(Options options, std::function<void(uint64_t)> on_rotate = {})
+        : options_(std::move(options)), rotate_handler_(std::move(on_rotate)) {
+        if (::mkdir(options_.dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw std::runtime_error("journal: mkdir " + options_.dir + ": " + std::strerror(errno));
+        }
+        auto existing = list_segments(options_.dir);
+        segment_ = existing.empty() ? 1 : existing.back().number + 1;
+        fd_ = open_segment(segment_.load(std::memory_order_relaxed));
+        worker_ = std::thread([this]() { run(); });
+    }
+
+    ~Journal() { stop(); }
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    const Options& options() const { return options_; }
+
+    // 当前写入的段号
+    uint64_t segment() const { return segment_.load(std::memory_order_acquire); }
+
+    // 任意线程调用：编码后入队，立即返回
+    void append(const nlohmann::json& record) {
+        std::vector<uint8_t> payload = nlohmann::json::to_cbor(record);
+        Item item;
+        item.bytes.reserve(payload.size() + 8);
+        put_u32(item.bytes, static_cast<uint32_t>(payload.size()));
+        put_u32(item.bytes, static_cast<uint32_t>(crc32(0L, payload.data(), static_cast<uInt>(payload.size()))));
+        item.bytes.append(reinterpret_cast<const char*>(payload.data()), payload.size());
+        incoming_.push(std::move(item));
+    }
+
+    // 所有房间都已在不早于segment的段中写过快照：此前入队的记录落盘后删除更早的段
+    void retire_before(uint64_t segment) {
+        Item item;
+        item.retire_before = segment;
+        incoming_.push(std::move(item));
+    }
+
+    // 停止后台线程，队列中剩余的记录写完并落盘
+    void stop() {
+        running_.store(false, std::memory_order_release);
+        if (worker_.joinable()) worker_.join();
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    // 按段号排序的已有段
+    static std::vector<Segment> list_segments(const std::string& dir) {
+        std::vector<Segment> segments;
+        DIR* d = ::opendir(dir.c_str());
+        if (!d) return segments;
+        while (dirent* entry = ::readdir(d)) {
+            unsigned long long number = 0;
+            char tail = 0;
+            if (std::sscanf(entry->d_name, "journal.%llu.lo%c", &number, &tail) == 2 && tail == 'g') {
+                segments.push_back(Segment{number, dir + "/" + entry->d_name});
+            }
+        }
+        ::closedir(d);
+        std::sort(segments.begin(), segments.end(),
+                  [](const Segment& a, const Segment& b) { return a.number < b.number; });
+        return segments;
+    }
+
+    // 依次解码一个段中的记录；遇到不完整或校验失败的尾部时停止并记一条警告。返回读到的记录数
+    static size_t read_segment(const std::string& path, const std::function<void(const nlohmann::json&)>& on_record) {
+        std::string data;
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) {
+            LOG_ERROR("journal segment not readable", {{"path", path}, {"error", std::strerror(errno)}});
+            return 0;
+        }
+        char buffer[65536];
+        size_t n;
+        while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) data.append(buffer, n);
+        std::fclose(file);
+
+        size_t offset = 0;
+        size_t records = 0;
+        while (offset + 8 <= data.size()) {
+            uint32_t length = get_u32(data, offset);
+            uint32_t crc = get_u32(data, offset + 4);
+            if (offset + 8 + length > data.size()) break;
+            const auto* payload = reinterpret_cast<const uint8_t*>(data.data() + offset + 8);
+            if (static_cast<uint32_t>(crc32(0L, payload, length)) != crc) break;
+            nlohmann::json record = nlohmann::json::from_cbor(payload, payload + length, true, false);
+            if (record.is_discarded()) break;
+            on_record(record);
+            ++records;
+            offset += 8 + length;
+        }
+        if (offset != data.size()) {
+            LOG_WARN("journal segment has a torn tail", {{"path", path}, {"valid_bytes", offset},
+                                                          {"dropped_bytes", data.size() - offset}});
+        }
+        return records;
+    }
+
+    // 统计，供指标导出
+    const LatencyHistogram& fsync_histogram() const { return fsync_us_; }
+    uint64_t records() const { return records_.load(std::memory_order_relaxed); }
+    uint64_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+    uint64_t commits() const { return commits_.load(std::memory_order_relaxed); }
+    uint64_t errors() const { return errors_.load(std::memory_order_relaxed); }
+    int64_t backlog() const { return incoming_.size_approx(); }
+
+private:
+    struct Item {
+        std::string bytes;
+        uint64_t retire_before = 0;
+    };
+
+    static void put_u32(std::string& out, uint32_t v) {
+        for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+    }
+
+    static uint32_t get_u32(const std::string& data, size_t offset) {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i) v |= static_cast<uint32_t>(static_cast<uint8_t>(data[offset + i])) << (8 * i);
+        return v;
+    }
+
+    std::string segment_path(uint64_t number) const {
+        char name[48];
+        std::snprintf(name, sizeof(name), "/journal.%08llu.log", static_cast<unsigned long long>(number));
+        return options_.dir + name;
+    }
+
+    int open_segment(uint64_t number) const {
+        std::string path = segment_path(number);
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("journal: open " + path + ": " + std::strerror(errno));
+        }
+        // 新文件的目录项也要落盘
+        int dir = ::open(options_.dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir >= 0) {
+            ::fsync(dir);
+            ::close(dir);
+        }
+        return fd;
+    }
+
+    void run() {
+        Item item;
+        std::string batch;                 // 未提交的记录，写入失败时保留到下次重试
+        uint64_t count = 0;
+        std::vector<uint64_t> retire;      // 须在此前入队的记录落盘之后执行
+        while (true) {
+            bool stopping = !running_.load(std::memory_order_acquire);
+            uint64_t arrived = 0;
+            while (incoming_.pop(item)) {
+                if (item.retire_before != 0) {
+                    retire.push_back(item.retire_before);
+                } else {
+                    batch += item.bytes;
+                    ++count;
+                }
+                ++arrived;
+            }
+            if ((rotate_now_ || segment_bytes_ >= options_.segment_bytes) &&
+                std::chrono::steady_clock::now() >= rotate_retry_at_) {
+                rotate();
+            }
+            bool failed = count > 0 && !commit(batch, count);
+            if (failed && batch.size() > options_.segment_bytes) {
+                // 积压超过一个段仍写不进去，放弃这一批，避免内存无限增长。
+                // 待执行的retire依赖各房间写在这一批里的快照，不能再删旧段；让房间在当前段重新写快照，之后重新发起retire
+                LOG_ERROR("journal records dropped", {{"records", count}, {"bytes", batch.size()}});
+                batch.clear();
+                count = 0;
+                retire.clear();
+                failed = false;
+                if (rotate_handler_) rotate_handler_(segment_.load(std::memory_order_relaxed));
+            }
+            if (!failed) {
+                batch.clear();
+                count = 0;
+                for (uint64_t segment : retire) remove_before(segment);
+                retire.clear();
+            }
+            if (stopping) {
+                if (failed) LOG_ERROR("journal stopped with uncommitted records", {{"records", count}});
+                break;
+            }
+            if (failed) {
+                std::this_thread::sleep_for(kRetryInterval);
+            } else if (arrived == 0) {
+                // 刚提交过就立即检查下一批，期间到达的记录自然攒成一批；空闲时才等待
+                std::this_thread::sleep_for(options_.commit_interval);
+            }
+        }
+    }
+
+    // 返回false时段中不留下这一批的任何字节，调用方稍后整批重试
+    bool commit(const std::string& batch, uint64_t count) {
+        size_t written = 0;
+        while (written < batch.size()) {
+            ssize_t n = ::write(fd_, batch.data() + written, batch.size() - written);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                errors_.fetch_add(1, std::memory_order_relaxed);
+                LOG_ERROR("journal write failed", {{"error", std::strerror(errno)}, {"records", count},
+                                                   {"written", written}});
+                if (written > 0) discard_uncommitted();
+                return false;
+            }
+            written += static_cast<size_t>(n);
+        }
+        auto started = std::chrono::steady_clock::now();
+        int synced = ::fdatasync(fd_);
+        fsync_us_.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - started).count()));
+        if (synced != 0) {
+            // fdatasync失败后页缓存中的内容不再可信，这一批按未提交处理，并换到新段重试
+            errors_.fetch_add(1, std::memory_order_relaxed);
+            LOG_ERROR("journal fdatasync failed", {{"error", std::strerror(errno)}, {"records", count}});
+            discard_uncommitted();
+            rotate_now_ = true;
+            return false;
+        }
+        segment_bytes_ += batch.size();
+        records_.fetch_add(count, std::memory_order_relaxed);
+        bytes_.fetch_add(batch.size(), std::memory_order_relaxed);
+        commits_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // 写了一半的记录会让读取在此处停止，丢掉其后的全部记录：截回最后一条完整记录之后，截不掉时立即换段
+    void discard_uncommitted() {
+        if (::ftruncate(fd_, static_cast<off_t>(segment_bytes_)) != 0) {
+            LOG_ERROR("journal truncate failed", {{"error", std::strerror(errno)}});
+            rotate_now_ = true;
+        }
+    }
+
+    // 先打开新段再关闭旧段：失败时段号不变，继续写旧段，kRetryInterval后再试
+    void rotate() {
+        uint64_t next = segment_.load(std::memory_order_relaxed) + 1;
+        int fd;
+        try {
+            fd = open_segment(next);
+        } catch (const std::exception& e) {
+            errors_.fetch_add(1, std::memory_order_relaxed);
+            rotate_retry_at_ = std::chrono::steady_clock::now() + kRetryInterval;
+            LOG_ERROR("journal rotation failed", {{"error", e.what()}});
+            return;
+        }
+        ::close(fd_);
+        fd_ = fd;
+        segment_bytes_ = 0;
+        rotate_now_ = false;
+        segment_.store(next, std::memory_order_release);
+        LOG_INFO("journal rotated", {{"segment", next}});
+        if (rotate_handler_) rotate_handler_(next);
+    }
+
+    void remove_before(uint64_t segment) {
+        for (const auto& old : list_segments(options_.dir)) {
+            if (old.number >= segment) break;
+            if (::unlink(old.path.c_str()) == 0) {
+                LOG_INFO("journal segment retired", {{"path", old.path}});
+            }
+        }
+    }
+
+    const Options options_;
+    const std::function<void(uint64_t)> rotate_handler_;
+    MpscQueue<Item> incoming_;
+    std::atomic<uint64_t> segment_{0};
+    // 以下只由后台线程访问
+    int fd_ = -1;
+    uint64_t segment_bytes_ = 0;       // 当前段中已完整落盘的字节数
+    bool rotate_now_ = false;          // 当前段已不可信，不等写满就换段
+    std::chrono::steady_clock::time_point rotate_retry_at_;
+
+    LatencyHistogram fsync_us_;
+    std::atomic<uint64_t> records_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> commits_{0};
+    std::atomic<uint64_t> errors_{0};
+    std::atomic<bool> running_{true};
+    std::thread worker_;
+};
+
+#endif
@@ -0,0 +1,346 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <variant>
+#include <vector>
+#include "concurrent_queue1_0.hpp"
+
+// 异步日志
+//  - 每个线程一个单生产者环形缓冲区，写日志只做一次拷贝和几次原子操作，缓冲区满时丢弃并计数，从不阻塞调用线程
+//  - 后台线程批量取出各缓冲区的记录，按时间排序后格式化并一次写出；空闲时睡在条件变量上，只有它睡着时写日志才加锁唤醒
+//  - 级别分编译期（XEMK_LOG_COMPILED_LEVEL）和运行期（Logger::set_level）两层；
+//    通过LOG_*宏写日志时，级别未开启的语句连参数都不会求值
+//  - 结构化字段以原始值保存，由后台线程格式化为 key=value
+
+enum class LogLevel : uint8_t { debug = 0, info = 1, warn = 2, error = 3, off = 4 };
+
+// 低于该级别的LOG_*语句在编译期被去掉，0-4对应debug到off
+#ifndef XEMK_LOG_COMPILED_LEVEL
+#define XEMK_LOG_COMPILED_LEVEL 0
+#endif
+
+// 一个结构化字段，值在后台线程中才格式化
+struct LogField {
+    using Value = std::variant<std::monostate, int64_t, uint64_t, double, bool, std::string>;
+
+    const char* key = "";
+    Value value;
+
+    LogField() = default;
+    LogField(const char* k, std::string v) : key(k), value(std::move(v)) {}
+    LogField(const char* k, const char* v) : key(k), value(std::string(v)) {}
+    LogField(const char* k, bool v) : key(k), value(v) {}
+    LogField(const char* k, double v) : key(k), value(v) {}
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+    LogField(const char* k, T v)
+        : key(k), value(std::is_signed_v<T> ? Value(static_cast<int64_t>(v)) : Value(static_cast<uint64_t>(v))) {}
+};
+
+class Logger {
+public:
+    static constexpr size_t kMaxFields = 6;
+    static constexpr size_t kRingCapacity = 4096;
+
+    struct Record {
+        LogLevel level = LogLevel::info;
+        std::chrono::system_clock::time_point time;
+        uint32_t thread = 0;
+        std::string message;
+        std::array<LogField, kMaxFields> fields;
+        uint8_t field_count = 0;
+    };
+
+    static void set_level(LogLevel level) { runtime_level().store(level, std::memory_order_relaxed); }
+
+    static bool enabled(LogLevel level) {
+        return level >= runtime_level().load(std::memory_order_relaxed) && level != LogLevel::off;
+    }
+
+    static void write(LogLevel level, std::string message, std::initializer_list<LogField> fields = {}) {
+        ThreadRing& ring = thread_ring();
+        Record record;
+        record.level = level;
+        record.time = std::chrono::system_clock::now();
+        record.thread = ring.id;
+        record.message = std::move(message);
+        for (const auto& field : fields) {
+            if (record.field_count == kMaxFields) break;
+            record.fields[record.field_count++] = field;
+        }
+        if (!ring.push(std::move(record))) {
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        Writer& w = writer();
+        w.ensure_running();
+        w.wake();
+    }
+
+    // 兼容原有的调用方式，消息在调用处已经拼好
+    static void info(const std::string& message) {
+        if (enabled(LogLevel::info)) write(LogLevel::info, message);
+    }
+
+    static void error(const std::string& message) {
+        if (enabled(LogLevel::error)) write(LogLevel::error, message);
+    }
+
+    // 等后台线程写完目前为止的所有记录，用于退出前
+    static void flush() { writer().flush(); }
+
+    static LogLevel parse_level(const std::string& name) {
+        if (name == "debug") return LogLevel::debug;
+        if (name == "warn") return LogLevel::warn;
+        if (name == "error") return LogLevel::error;
+        if (name == "off") return LogLevel::off;
+        return LogLevel::info;
+    }
+
+private:
+    // 单生产者（所属线程）单消费者（后台线程）的定长环形缓冲区
+    struct ThreadRing {
+        uint32_t id = 0;
+        std::vector<Record> slots = std::vector<Record>(kRingCapacity);
+        alignas(kCacheLineSize) std::atomic<size_t> head{0}; // 生产者写入位置
+        alignas(kCacheLineSize) std::atomic<size_t> tail{0}; // 消费者读取位置
+        alignas(kCacheLineSize) std::atomic<uint64_t> dropped{0};
+
+        bool push(Record&& record) {
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h - tail.load(std::memory_order_acquire) >= kRingCapacity) return false;
+            slots[h % kRingCapacity] = std::move(record);
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        template <typename Out>
+        void drain(Out& out) {
+            size_t t = tail.load(std::memory_order_relaxed);
+            size_t h = head.load(std::memory_order_acquire);
+            for (; t != h; ++t) {
+                out.push_back(std::move(slots[t % kRingCapacity]));
+            }
+            tail.store(t, std::memory_order_release);
+        }
+    };
+
+    class Writer {
+    public:
+        Writer() {
+            pthread_atfork(nullptr, nullptr, &Writer::after_fork_child);
+        }
+
+        ~Writer() {
+            stop_.store(true);
+            {
+                std::lock_guard<std::mutex> lock(wake_mutex_);
+                sleeping_.store(false, std::memory_order_relaxed);
+                wake_.notify_one();
+            }
+            if (thread_ && thread_->joinable()) thread_->join();
+            drain_once();
+        }
+
+        void add(std::shared_ptr<ThreadRing> ring) {
+            std::lock_guard<std::mutex> lock(rings_mutex_);
+            rings_.push_back(std::move(ring));
+        }
+
+        void ensure_running() {
+            if (running_.load(std::memory_order_acquire)) return;
+            std::lock_guard<std::mutex> lock(start_mutex_);
+            if (running_.load(std::memory_order_relaxed)) return;
+            thread_ = std::make_unique<std::thread>([this]() { run(); });
+            running_.store(true, std::memory_order_release);
+        }
+
+        // 写入记录后调用：后台线程正在睡眠时唤醒它
+        void wake() {
+            // 与run()中的栅栏配对：要么后台线程看到新记录，要么这里看到它已睡眠
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleeping_.load(std::memory_order_relaxed) && sleeping_.exchange(false)) {
+                std::lock_guard<std::mutex> lock(wake_mutex_);
+                wake_.notify_one();
+            }
+        }
+
+        void flush() {
+            std::lock_guard<std::mutex> lock(drain_mutex_);
+            drain_locked();
+        }
+
+    private:
+        // 兜底的最长睡眠时间，只为及时报告丢弃计数；正常情况下由wake()唤醒
+        static constexpr auto kMaxIdleWait = std::chrono::milliseconds(100);
+
+        // fork出的子进程中没有后台线程：放弃父进程的线程对象（不能join也不能析构），下一次写日志时重新启动
+        static void after_fork_child() {
+            Writer& w = writer();
+            w.thread_.release();
+            new (&w.start_mutex_) std::mutex();
+            new (&w.rings_mutex_) std::mutex();
+            new (&w.drain_mutex_) std::mutex();
+            new (&w.wake_mutex_) std::mutex();
+            new (&w.wake_) std::condition_variable();
+            w.sleeping_.store(false);
+            w.running_.store(false);
+        }
+
+        void run() {
+            while (!stop_.load(std::memory_order_relaxed)) {
+                if (drain_once() > 0) continue;
+                std::unique_lock<std::mutex> lock(wake_mutex_);
+                sleeping_.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (has_records() || stop_.load(std::memory_order_relaxed)) {
+                    sleeping_.store(false, std::memory_order_relaxed);
+                    continue;
+                }
+                wake_.wait_for(lock, kMaxIdleWait, [this]() { return !sleeping_.load(std::memory_order_relaxed); });
+                sleeping_.store(false, std::memory_order_relaxed);
+            }
+        }
+
+        bool has_records() {
+            std::lock_guard<std::mutex> lock(rings_mutex_);
+            for (const auto& ring : rings_) {
+                if (ring->head.load(std::memory_order_relaxed) != ring->tail.load(std::memory_order_relaxed)) return true;
+            }
+            return false;
+        }
+
+        size_t drain_once() {
+            std::lock_guard<std::mutex> lock(drain_mutex_);
+            return drain_locked();
+        }
+
+        size_t drain_locked() {
+            std::vector<std::shared_ptr<ThreadRing>> rings;
+            {
+                std::lock_guard<std::mutex> lock(rings_mutex_);
+                rings = rings_;
+            }
+            batch_.clear();
+            uint64_t dropped = 0;
+            for (auto& ring : rings) {
+                ring->drain(batch_);
+                dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+            }
+            if (batch_.empty() && dropped == 0) return 0;
+
+            std::stable_sort(batch_.begin(), batch_.end(),
+                             [](const Record& a, const Record& b) { return a.time < b.time; });
+            out_.clear();
+            for (const auto& record : batch_) format(record, out_);
+            if (dropped) {
+                out_ += "[WARN] log rings full, dropped=" + std::to_string(dropped) + "\n";
+            }
+            fwrite(out_.data(), 1, out_.size(), stdout);
+            fflush(stdout);
+            return batch_.size();
+        }
+
+        static void format(const Record& record, std::string& out) {
+            static const char* names[] = {"[DEBUG] ", "[INFO] ", "[WARN] ", "[ERROR] ", ""};
+            std::time_t seconds = std::chrono::system_clock::to_time_t(record.time);
+            auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                              record.time.time_since_epoch()).count() % 1000000;
+            std::tm tm;
+            localtime_r(&seconds, &tm);
+            char stamp[40];
+            snprintf(stamp, sizeof(stamp), "%02d:%02d:%02d.%06lld t%u ", tm.tm_hour, tm.tm_min, tm.tm_sec,
+                     static_cast<long long>(micros), record.thread);
+            out += stamp;
+            out += names[static_cast<int>(record.level)];
+            out += record.message;
+            for (uint8_t i = 0; i < record.field_count; ++i) {
+                const LogField& field = record.fields[i];
+                out += ' ';
+                out += field.key;
+                out += '=';
+                std::visit([&out](const auto& v) {
+                    using V = std::decay_t<decltype(v)>;
+                    if constexpr (std::is_same_v<V, std::string>) {
+                        out += v;
+                    } else if constexpr (std::is_same_v<V, bool>) {
+                        out += v ? "true" : "false";
+                    } else if constexpr (std::is_same_v<V, std::monostate>) {
+                        out += "-";
+                    } else {
+                        out += std::to_string(v);
+                    }
+                }, field.value);
+            }
+            out += '\n';
+        }
+
+        std::mutex start_mutex_;
+        std::mutex rings_mutex_;
+        std::mutex drain_mutex_;
+        std::vector<std::shared_ptr<ThreadRing>> rings_;
+        std::vector<Record> batch_;
+        std::string out_;
+        std::unique_ptr<std::thread> thread_;
+        std::atomic<bool> running_{false};
+        std::atomic<bool> stop_{false};
+        std::atomic<bool> sleeping_{false};
+        std::mutex wake_mutex_;
+        std::condition_variable wake_;
+    };
+
+    static std::atomic<LogLevel>& runtime_level() {
+        static std::atomic<LogLevel> level{LogLevel::info};
+        return level;
+    }
+
+    static Writer& writer() {
+        static Writer w;
+        return w;
+    }
+
+    // 线程第一次写日志时创建自己的缓冲区并登记给后台线程；线程退出后缓冲区由后台线程继续持有
+    static ThreadRing& thread_ring() {
+        thread_local std::shared_ptr<ThreadRing> ring = []() {
+            static std::atomic<uint32_t> next_id{0};
+            auto r = std::make_shared<ThreadRing>();
+            r->id = next_id.fetch_add(1, std::memory_order_relaxed);
+            writer().add(r);
+            return r;
+        }();
+        return *ring;
+    }
+};
+
+// 编译期级别判断放在函数里，默认级别0时比较恒为真，写在宏里会在每条日志处触发-Wtype-limits
+constexpr bool log_compiled_in(LogLevel level) {
+    int value = static_cast<int>(level);
+    return value >= XEMK_LOG_COMPILED_LEVEL;
+}
+
+#define XEMK_LOG(level, ...)                                                          \
+    do {                                                                              \
+        if constexpr (log_compiled_in(level)) {                                       \
+            if (Logger::enabled(level)) Logger::write(level, __VA_ARGS__);            \
+        }                                                                             \
+    } while (0)
+
+#define LOG_DEBUG(...) XEMK_LOG(LogLevel::debug, __VA_ARGS__)
+#define LOG_INFO(...) XEMK_LOG(LogLevel::info, __VA_ARGS__)
+#define LOG_WARN(...) XEMK_LOG(LogLevel::warn, __VA_ARGS__)
+#define LOG_ERROR(...) XEMK_LOG(LogLevel::error, __VA_ARGS__)
+
+#endif
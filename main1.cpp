@@ -1,20 +1,56 @@
 
 #include "server1_8.hpp"
+#include "supervisor1_0.hpp"
 
 // 主函数
-int main() {
+int main(int argc, char* argv[]) {
     try {
         std::cout << "Starting Game Server..." << std::endl;
-        
+
+        ServerConfig config = ServerConfig::from_args(argc, argv);
+
+        if (config.workers > 1) {
+            // 卡牌目录在fork之前构建，各工作进程共享只读副本
+            CardCatalog::shared();
+            WorkerSupervisor::block_signals();
+            int worker = WorkerSupervisor(config.workers).run();
+            if (worker < 0) {
+                std::cout << "All workers stopped" << std::endl;
+                return 0;
+            }
+
+            // 工作进程：运行服务器直到收到SIGTERM/SIGINT
+            config.worker_index = static_cast<size_t>(worker);
+            auto game_server = std::make_shared<GameServer>(config);
+            sigset_t signals;
+            sigemptyset(&signals);
+            sigaddset(&signals, SIGTERM);
+            sigaddset(&signals, SIGINT);
+            int signo = 0;
+            sigwait(&signals, &signo);
+            std::cout << "Worker " << worker << " shutting down..." << std::endl;
+            game_server->drain();
+            return 0;
+        }
+
+        // 在创建任何线程之前阻塞退出信号，由主线程sigwait统一处理
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGTERM);
+        sigaddset(&signals, SIGINT);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
         // 创建游戏服务器实例
-        auto game_server = std::make_shared<GameServer>();
+        auto game_server = std::make_shared<GameServer>(config);
         
-        std::cout << "Game server is running on port 8002. Press Enter to exit..." << std::endl;
+        std::cout << "Game server is running on port " << config.port << ". Send SIGTERM or press Ctrl+C to exit..." << std::endl;
         
-        // 等待用户输入以保持服务器运行
-        std::cin.get();
+        // 等待退出信号；排空时进行中的对局转存到state_file，下次启动时恢复
+        int signo = 0;
+        sigwait(&signals, &signo);
         
         std::cout << "Shutting down game server..." << std::endl;
+        game_server->drain();
         
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
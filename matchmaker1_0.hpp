@@ -0,0 +1,239 @@
+#ifndef MATCHMAKER_HPP
+#define MATCHMAKER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "concurrent_queue1_0.hpp"
+#include "metrics1_0.hpp"
+
+// 一名排队中的玩家
+// closed由连接线程在断开时置位，匹配线程据此丢弃或撤销该玩家
+struct MatchTicket {
+    std::weak_ptr<void> owner;          // 连接句柄
+    std::string preferred_seat;         // "player1"/"player2"，空表示任意座位
+    std::chrono::steady_clock::time_point enqueued_at = std::chrono::steady_clock::now();
+    std::atomic<bool> closed{false};
+};
+
+// 匹配服务：加入请求经无锁MPSC队列交给单独的匹配线程，由它按座位偏好两两配对后回调建房
+// 入队只有一次原子交换，突发的大量加入不会争抢同一把锁；匹配线程空闲时睡在条件变量上，只有它睡着时入队才加锁唤醒
+class Matchmaker {
+public:
+    struct Stats {
+        int64_t depth = 0;          // 排队人数
+        uint64_t matched_pairs = 0; // 已配对数
+        uint64_t p50_wait_us = 0;
+        uint64_t p90_wait_us = 0;
+        uint64_t p99_wait_us = 0;
+        uint64_t max_wait_us = 0;
+    };
+
+    using Ticket = std::shared_ptr<MatchTicket>;
+    // 回调在匹配线程上执行，first坐player1，second坐player2
+    using MatchCallback = std::function<void(const Ticket& first, const Ticket& second)>;
+    using ReportCallback = std::function<void(const Stats&)>;
+
+    explicit Matchmaker(MatchCallback on_match, ReportCallback on_report = nullptr)
+        : on_match_(std::move(on_match)), on_report_(std::move(on_report)) {
+        worker_ = std::thread([this]() { run(); });
+    }
+
+    ~Matchmaker() {
+        running_.store(false, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            sleeping_.store(false, std::memory_order_relaxed);
+            wake_.notify_one();
+        }
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+    }
+
+    Matchmaker(const Matchmaker&) = delete;
+    Matchmaker& operator=(const Matchmaker&) = delete;
+
+    void enqueue(Ticket ticket) {
+        depth_.fetch_add(1, std::memory_order_relaxed);
+        incoming_.push(std::move(ticket));
+        // 与run()中的栅栏配对：要么匹配线程看到新玩家，要么这里看到它已睡眠
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping_.load(std::memory_order_relaxed) && sleeping_.exchange(false)) {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            wake_.notify_one();
+        }
+    }
+
+    // 连接断开时调用，匹配线程会在下一轮丢弃该玩家
+    static void cancel(const Ticket& ticket) {
+        ticket->closed.store(true);
+    }
+
+    Stats stats() const {
+        Stats stats;
+        stats.depth = depth_.load(std::memory_order_relaxed);
+        stats.matched_pairs = matched_pairs_.load(std::memory_order_relaxed);
+        stats.p50_wait_us = wait_us_.percentile(0.50);
+        stats.p90_wait_us = wait_us_.percentile(0.90);
+        stats.p99_wait_us = wait_us_.percentile(0.99);
+        stats.max_wait_us = wait_us_.max();
+        return stats;
+    }
+
+    const LatencyHistogram& wait_histogram() const { return wait_us_; }
+
+private:
+    static constexpr auto kPurgeInterval = std::chrono::milliseconds(100);
+    static constexpr auto kReportInterval = std::chrono::seconds(10);
+
+    enum SeatQueue { kAny = 0, kPlayer1 = 1, kPlayer2 = 2 };
+
+    static bool is_closed(const Ticket& ticket) {
+        return ticket->closed.load() || ticket->owner.expired();
+    }
+
+    void run() {
+        auto last_purge = std::chrono::steady_clock::now();
+        auto last_report = last_purge;
+        uint64_t reported_pairs = 0;
+        while (running_.load(std::memory_order_acquire)) {
+            bool drained = false;
+            Ticket ticket;
+            while (incoming_.pop(ticket)) {
+                drained = true;
+                waiting_[seat_queue_of(ticket->preferred_seat)].push_back(std::move(ticket));
+            }
+            if (drained) {
+                pair_waiting();
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (now - last_purge >= kPurgeInterval) {
+                purge_closed();
+                last_purge = now;
+            }
+            if (on_report_ && now - last_report >= kReportInterval) {
+                uint64_t pairs = matched_pairs_.load(std::memory_order_relaxed);
+                if (pairs != reported_pairs || depth_.load(std::memory_order_relaxed) > 0) {
+                    on_report_(stats());
+                    reported_pairs = pairs;
+                }
+                last_report = now;
+            }
+            if (!drained) {
+                // 有人排队时睡到下一次清理，否则睡到下一次汇报，期间由enqueue()唤醒
+                bool waiting = !waiting_[kAny].empty() || !waiting_[kPlayer1].empty() || !waiting_[kPlayer2].empty();
+                wait_for_ticket(waiting ? last_purge + kPurgeInterval : last_report + kReportInterval);
+            }
+        }
+    }
+
+    void wait_for_ticket(std::chrono::steady_clock::time_point deadline) {
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        sleeping_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (incoming_.size_approx() > 0 || !running_.load(std::memory_order_acquire)) {
+            sleeping_.store(false, std::memory_order_relaxed);
+            return;
+        }
+        wake_.wait_until(lock, deadline, [this]() { return !sleeping_.load(std::memory_order_relaxed); });
+        sleeping_.store(false, std::memory_order_relaxed);
+    }
+
+    static SeatQueue seat_queue_of(const std::string& seat) {
+        if (seat == "player1") return kPlayer1;
+        if (seat == "player2") return kPlayer2;
+        return kAny;
+    }
+
+    // 去掉队首已断开的玩家
+    void drop_closed_front(std::deque<Ticket>& queue) {
+        while (!queue.empty() && is_closed(queue.front())) {
+            queue.pop_front();
+            depth_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    void purge_closed() {
+        for (auto& queue : waiting_) {
+            for (auto it = queue.begin(); it != queue.end();) {
+                if (is_closed(*it)) {
+                    it = queue.erase(it);
+                    depth_.fetch_sub(1, std::memory_order_relaxed);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    // 优先让指定了不同座位的玩家配对，其次与任意座位的玩家配对
+    void pair_waiting() {
+        auto& any = waiting_[kAny];
+        auto& player1 = waiting_[kPlayer1];
+        auto& player2 = waiting_[kPlayer2];
+        for (;;) {
+            drop_closed_front(any);
+            drop_closed_front(player1);
+            drop_closed_front(player2);
+            if (!player1.empty() && !player2.empty()) {
+                pair(player1, player2);
+            } else if (!player1.empty() && !any.empty()) {
+                pair(player1, any);
+            } else if (!player2.empty() && !any.empty()) {
+                pair(any, player2);
+            } else if (any.size() >= 2) {
+                // 第二名可能已断开，单独检查
+                if (is_closed(any[1])) {
+                    any.erase(any.begin() + 1);
+                    depth_.fetch_sub(1, std::memory_order_relaxed);
+                    continue;
+                }
+                pair(any, any);
+            } else {
+                break;
+            }
+        }
+    }
+
+    void pair(std::deque<Ticket>& first_queue, std::deque<Ticket>& second_queue) {
+        Ticket first = std::move(first_queue.front());
+        first_queue.pop_front();
+        Ticket second = std::move(second_queue.front());
+        second_queue.pop_front();
+
+        auto now = std::chrono::steady_clock::now();
+        for (const Ticket* ticket : {&first, &second}) {
+            auto waited = std::chrono::duration_cast<std::chrono::microseconds>(now - (*ticket)->enqueued_at);
+            wait_us_.record(static_cast<uint64_t>(waited.count()));
+        }
+        depth_.fetch_sub(2, std::memory_order_relaxed);
+        matched_pairs_.fetch_add(1, std::memory_order_relaxed);
+        on_match_(first, second);
+    }
+
+    MatchCallback on_match_;
+    ReportCallback on_report_;
+
+    MpscQueue<Ticket> incoming_;
+    std::deque<Ticket> waiting_[3]; // 只由匹配线程访问
+
+    alignas(kCacheLineSize) std::atomic<int64_t> depth_{0};
+    std::atomic<uint64_t> matched_pairs_{0};
+    LatencyHistogram wait_us_;
+
+    std::atomic<bool> sleeping_{false};
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    std::atomic<bool> running_{true};
+    std::thread worker_;
+};
+
+#endif
@@ -0,0 +1,283 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// HDR风格的延迟直方图：每个2的幂区间再细分8个子桶，相对误差约12.5%
+// record只做一次relaxed原子加，可以在任意线程上常开
+class LatencyHistogram {
+public:
+    static constexpr int kSubBits = 3;
+    static constexpr uint64_t kSubBuckets = 1u << kSubBits;
+    static constexpr size_t kBucketCount = (64 - kSubBits + 1) * kSubBuckets;
+
+    void record(uint64_t value) {
+        buckets_[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+        uint64_t prev_max = max_.load(std::memory_order_relaxed);
+        while (value > prev_max &&
+               !max_.compare_exchange_weak(prev_max, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    uint64_t bucket_count(size_t index) const { return buckets_[index].load(std::memory_order_relaxed); }
+
+    // 返回分位数q(0~1)所在桶的上界
+    uint64_t percentile(double q) const {
+        uint64_t total = count();
+        if (total == 0) return 0;
+        uint64_t target = static_cast<uint64_t>(q * static_cast<double>(total));
+        if (target >= total) target = total - 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen > target) {
+                uint64_t upper = bucket_upper(i);
+                return upper < max() ? upper : max();
+            }
+        }
+        return max();
+    }
+
+    static size_t bucket_of(uint64_t value) {
+        if (value < kSubBuckets) return static_cast<size_t>(value);
+        int msb = 63 - __builtin_clzll(value);
+        uint64_t sub = (value >> (msb - kSubBits)) & (kSubBuckets - 1);
+        return static_cast<size_t>((msb - kSubBits + 1) * kSubBuckets + sub);
+    }
+
+    static uint64_t bucket_upper(size_t index) {
+        if (index < kSubBuckets) return index;
+        int msb = static_cast<int>(index / kSubBuckets) - 1 + kSubBits;
+        uint64_t sub = index % kSubBuckets;
+        uint64_t lower = (uint64_t(1) << msb) | (sub << (msb - kSubBits));
+        return lower + (uint64_t(1) << (msb - kSubBits)) - 1;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, kBucketCount> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// 单调递增计数器
+class Counter {
+public:
+    void inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// 可增可减的瞬时值
+class Gauge {
+public:
+    void set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+    void add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+// 作用域计时：析构时把经过的微秒数记入直方图，histogram为空时不计时
+class ScopedTimer {
+public:
+    explicit ScopedTimer(LatencyHistogram* histogram)
+        : histogram_(histogram), start_(histogram ? std::chrono::steady_clock::now()
+                                                  : std::chrono::steady_clock::time_point()) {}
+    ~ScopedTimer() {
+        if (!histogram_) return;
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        histogram_->record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    LatencyHistogram* histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// 指标注册表，按Prometheus文本格式（0.0.4）导出
+// 指标在启动时注册一次，调用方保存返回的引用，记录时不经过注册表；注册和导出之间加锁
+// 直方图以微秒记录，导出为秒，HDR桶按固定的le边界累加（桶上界不超过边界的计入该边界）
+class MetricsRegistry {
+public:
+    // labels为已格式化的标签，如 type="player_action"，可为空
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        counters_.emplace_back();
+        add_series(name, help, "counter", labels, Series{&counters_.back(), nullptr, nullptr, {}, {}});
+        return counters_.back();
+    }
+
+    Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        gauges_.emplace_back();
+        add_series(name, help, "gauge", labels, Series{nullptr, &gauges_.back(), nullptr, {}, {}});
+        return gauges_.back();
+    }
+
+    // 导出时才求值的指标，用于已有的统计量（房间数、队列深度等）
+    void gauge(const std::string& name, const std::string& help, const std::string& labels,
+               std::function<double()> sample) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        add_series(name, help, "gauge", labels, Series{nullptr, nullptr, nullptr, std::move(sample), {}});
+    }
+
+    void counter(const std::string& name, const std::string& help, const std::string& labels,
+                 std::function<double()> sample) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        add_series(name, help, "counter", labels, Series{nullptr, nullptr, nullptr, std::move(sample), {}});
+    }
+
+    LatencyHistogram& histogram(const std::string& name, const std::string& help, const std::string& labels = "") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        histograms_.emplace_back();
+        add_series(name, help, "histogram", labels, Series{nullptr, nullptr, &histograms_.back(), {}, {}});
+        return histograms_.back();
+    }
+
+    // 导出别处持有的直方图（单位微秒），histogram需比注册表活得久
+    void histogram(const std::string& name, const std::string& help, const std::string& labels,
+                   const LatencyHistogram& histogram) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        add_series(name, help, "histogram", labels, Series{nullptr, nullptr, &histogram, {}, {}});
+    }
+
+    // 自行输出若干行样本的导出回调，用于标签集合在运行中才确定的统计（如按消息类型的压缩统计）
+    void collector(std::function<void(std::string& out)> collect) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        collectors_.push_back(std::move(collect));
+    }
+
+    std::string render() const {
+        std::string out;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& family : families_) {
+            out += "# HELP " + family.name + " " + family.help + "\n";
+            out += "# TYPE " + family.name + " " + family.type + "\n";
+            for (const auto& series : family.series) {
+                if (series.histogram) {
+                    render_histogram(out, family.name, series.labels, *series.histogram);
+                } else {
+                    double value = series.counter ? static_cast<double>(series.counter->value())
+                                   : series.gauge ? static_cast<double>(series.gauge->value())
+                                                  : series.sample();
+                    append_sample(out, family.name, series.labels, value);
+                }
+            }
+        }
+        for (const auto& collect : collectors_) {
+            collect(out);
+        }
+        return out;
+    }
+
+    // 标签值中的反斜杠、双引号和换行按文本格式转义，用于客户端给出的房间号等
+    static std::string escape_label(const std::string& value) {
+        std::string out;
+        out.reserve(value.size());
+        for (char c : value) {
+            if (c == '\\' || c == '"') {
+                out += '\\';
+                out += c;
+            } else if (c == '\n') {
+                out += "\\n";
+            } else {
+                out += c;
+            }
+        }
+        return out;
+    }
+
+    static void append_sample(std::string& out, const std::string& name, const std::string& labels, double value) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.12g", value);
+        out += name;
+        if (!labels.empty()) out += "{" + labels + "}";
+        out += " ";
+        out += buf;
+        out += "\n";
+    }
+
+private:
+    struct Series {
+        const Counter* counter;
+        const Gauge* gauge;
+        const LatencyHistogram* histogram;
+        std::function<double()> sample;
+        std::string labels;
+    };
+
+    struct Family {
+        std::string name;
+        std::string help;
+        std::string type;
+        std::vector<Series> series;
+    };
+
+    void add_series(const std::string& name, const std::string& help, const char* type,
+                    const std::string& labels, Series series) {
+        series.labels = labels;
+        for (auto& family : families_) {
+            if (family.name == name) {
+                family.series.push_back(std::move(series));
+                return;
+            }
+        }
+        families_.push_back(Family{name, help, type, {}});
+        families_.back().series.push_back(std::move(series));
+    }
+
+    static void render_histogram(std::string& out, const std::string& name, const std::string& labels,
+                                 const LatencyHistogram& histogram) {
+        // 单位微秒
+        static const uint64_t kBounds[] = {50, 100, 250, 500, 1000, 2500, 5000, 10000,
+                                           25000, 50000, 100000, 250000, 500000, 1000000};
+        std::string prefix = labels.empty() ? "" : labels + ",";
+        uint64_t cumulative = 0;
+        size_t bucket = 0;
+        for (uint64_t bound : kBounds) {
+            for (; bucket < LatencyHistogram::kBucketCount && LatencyHistogram::bucket_upper(bucket) <= bound; ++bucket) {
+                cumulative += histogram.bucket_count(bucket);
+            }
+            char le[32];
+            snprintf(le, sizeof(le), "%g", bound / 1e6);
+            append_sample(out, name + "_bucket", prefix + "le=\"" + le + "\"", static_cast<double>(cumulative));
+        }
+        for (; bucket < LatencyHistogram::kBucketCount; ++bucket) {
+            cumulative += histogram.bucket_count(bucket);
+        }
+        append_sample(out, name + "_bucket", prefix + "le=\"+Inf\"", static_cast<double>(cumulative));
+        append_sample(out, name + "_sum", labels, histogram.sum() / 1e6);
+        append_sample(out, name + "_count", labels, static_cast<double>(cumulative));
+    }
+
+    mutable std::mutex mutex_;
+    std::deque<Counter> counters_;     // deque保证已返回的引用不失效
+    std::deque<Gauge> gauges_;
+    std::deque<LatencyHistogram> histograms_;
+    std::vector<Family> families_;
+    std::vector<std::function<void(std::string&)>> collectors_;
+};
+
+#endif
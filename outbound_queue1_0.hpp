@@ -0,0 +1,171 @@
+#ifndef OUTBOUND_QUEUE_HPP
+#define OUTBOUND_QUEUE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "resend_buffer1_0.hpp"
+
+// 下行帧优先级：决定积压时哪些帧可以丢弃。发送顺序始终与入队顺序一致，
+// 带seq的帧若乱序，客户端确认了N+1就再也收不到N
+enum class SendPriority {
+    critical = 0, // game_end、player_hp等决定胜负和回合的消息
+    state = 1,    // 手牌、栏位、骨头数等完整状态，新的一条可以替代旧的
+    chatter = 2,  // 提示类消息，不带seq时积压可以丢弃
+};
+
+inline SendPriority priority_of(const std::string& type) {
+    if (type == "waiting_for_opponent" || type == "opponent_disconnected" ||
+        type == "opponent_reconnected" || type == "matchmaking_queued") {
+        return SendPriority::chatter;
+    }
+    if (type == "numbers_assigned" || type == "move_accepted" || type == "opponent_move" ||
+        type == "player_bonus") {
+        return SendPriority::state;
+    }
+    return SendPriority::critical;
+}
+
+// 整份状态类消息：队列里还没发出的旧消息会被同类型的新消息替代
+inline bool is_superseding(const std::string& type) {
+    return type == "numbers_assigned" || type == "move_accepted" || type == "opponent_move" ||
+           type == "player_bonus" || type == "player_hp";
+}
+
+// 单个连接的下行队列，带字节预算
+// 处理策略：
+//  1. 入队时先替换掉队列中同类型、尚未发出的整份状态消息（新消息序号更大，替换后仍按序号递增发出）
+//  2. 新帧一律排在队尾，不调整先后
+//  3. 超出预算时丢弃最早的不带seq的chatter消息
+//  4. 仍超出预算，或积压持续超过stall_timeout时返回overflow，由调用方断开该慢连接；
+//     客户端重连后通过补发/快照恢复状态，因此带seq的消息从不单独丢弃
+// 锁只保护本连接的队列，不同连接之间没有共享锁
+class OutboundQueue {
+public:
+    struct Limits {
+        size_t budget_bytes = 256 * 1024;         // 本队列最多积压的字节数
+        size_t transport_high_water = 64 * 1024; // websocketpp内部缓冲超过该值时暂停下发
+        std::chrono::milliseconds stall_timeout{10000};
+    };
+
+    enum class PushResult { queued, overflow };
+
+    struct GlobalStats {
+        std::atomic<int64_t> queued_bytes{0};   // 所有连接队列中的字节数
+        std::atomic<uint64_t> coalesced{0};     // 被新消息替代的帧数
+        std::atomic<uint64_t> shed{0};          // 被丢弃的chatter帧数
+        std::atomic<uint64_t> slow_disconnects{0};
+    };
+
+    static Limits& limits() {
+        static Limits limits;
+        return limits;
+    }
+
+    static GlobalStats& global_stats() {
+        static GlobalStats stats;
+        return stats;
+    }
+
+    ~OutboundQueue() {
+        global_stats().queued_bytes.fetch_sub(static_cast<int64_t>(bytes_.load()), std::memory_order_relaxed);
+    }
+
+    PushResult push(std::shared_ptr<const OutboundMessage> message) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const std::string& type = message->type;
+        if (is_superseding(type)) {
+            for (auto it = frames_.begin(); it != frames_.end(); ++it) {
+                if ((*it)->type == type) {
+                    remove_bytes((*it)->text.size());
+                    frames_.erase(it);
+                    global_stats().coalesced.fetch_add(1, std::memory_order_relaxed);
+                    break;
+                }
+            }
+        }
+        add_bytes(message->text.size());
+        frames_.push_back(std::move(message));
+
+        const Limits& lim = limits();
+        for (auto it = frames_.begin(); bytes_.load(std::memory_order_relaxed) > lim.budget_bytes && it != frames_.end();) {
+            if ((*it)->seq == 0 && priority_of((*it)->type) == SendPriority::chatter) {
+                remove_bytes((*it)->text.size());
+                it = frames_.erase(it);
+                global_stats().shed.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                ++it;
+            }
+        }
+        if (bytes_.load(std::memory_order_relaxed) > lim.budget_bytes || stalled_too_long()) {
+            return PushResult::overflow;
+        }
+        return PushResult::queued;
+    }
+
+    // 在锁内把帧交给send，transport_buffered返回websocketpp内部已缓冲的字节数
+    // 返回true表示队列已清空；否则调用方需要稍后再次flush
+    template <typename TransportBuffered, typename Send>
+    bool flush(TransportBuffered transport_buffered, Send send) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const Limits& lim = limits();
+        while (!frames_.empty() && transport_buffered() < lim.transport_high_water) {
+            auto message = std::move(frames_.front());
+            frames_.pop_front();
+            remove_bytes(message->text.size());
+            send(*message);
+        }
+        if (frames_.empty()) {
+            blocked_since_ = std::chrono::steady_clock::time_point();
+            return true;
+        }
+        if (blocked_since_ == std::chrono::steady_clock::time_point()) {
+            blocked_since_ = std::chrono::steady_clock::now();
+        }
+        return false;
+    }
+
+    // 定时重试下发前检查：websocketpp缓冲一直降不下来、积压超过stall_timeout时返回true
+    bool is_stalled() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !frames_.empty() && stalled_too_long();
+    }
+
+    // 断开慢连接时清空队列
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        remove_bytes(bytes_.load(std::memory_order_relaxed));
+        frames_.clear();
+    }
+
+    // 本连接积压的字节数（不含websocketpp内部缓冲）
+    size_t buffered_bytes() const {
+        return bytes_.load(std::memory_order_relaxed);
+    }
+
+private:
+    bool stalled_too_long() const {
+        return blocked_since_ != std::chrono::steady_clock::time_point() &&
+               std::chrono::steady_clock::now() - blocked_since_ > limits().stall_timeout;
+    }
+
+    void add_bytes(size_t n) {
+        bytes_.fetch_add(n, std::memory_order_relaxed);
+        global_stats().queued_bytes.fetch_add(static_cast<int64_t>(n), std::memory_order_relaxed);
+    }
+
+    void remove_bytes(size_t n) {
+        bytes_.fetch_sub(n, std::memory_order_relaxed);
+        global_stats().queued_bytes.fetch_sub(static_cast<int64_t>(n), std::memory_order_relaxed);
+    }
+
+    std::mutex mutex_;
+    std::deque<std::shared_ptr<const OutboundMessage>> frames_;
+    std::atomic<size_t> bytes_{0};
+    std::chrono::steady_clock::time_point blocked_since_;
+};
+
+#endif
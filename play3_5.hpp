@@ -1,5 +1,6 @@
 #ifndef PLAY_HPP
 #define PLAY_HPP
+#include <functional>
 #include "card3_5.hpp"
 // #include "server1_3.hpp"
 
@@ -12,6 +13,9 @@ using std::placeholders::_2;
 class play{ 
 
 public:
+    // 战斗中卡牌死亡时回调：卡牌所属玩家、栏位、卡牌（已从手牌移除但尚未释放）和该玩家获得骨头后的骨头数
+    std::function<void(const std::string& owner, int slot, const Card& card, int bones)> on_card_death;
+
     json send_move(std::vector<std::vector<Card*>> &slots_cards){
         // 发送移动接受消息
         json accept_response;
@@ -111,6 +115,7 @@ public:
                                     it = player_cards.erase(it);
                                     cur_player_bones+=1;
                                     //骨头🦴+=1
+                                    if (on_card_death) on_card_death(cur_player_id, i, *cur_card, cur_player_bones);
                                     break;
                                 }
                                 else{
@@ -167,6 +172,7 @@ public:
                                     it = player_cards.erase(it);
                                     //骨头🦴+=1
                                     last_player_bones+=1;
+                                    if (on_card_death) on_card_death(op_player_id, i, *op_card, last_player_bones);
                                     break;
                                 }
                                 else{
@@ -201,7 +207,8 @@ public:
 
     //12.29当前"card_placement_update"类型的信息中的"action"给出了add和clear两种，同时发送玩家对应id，
     //但是接收card_placement_update本身需要在on_massage中，同时需要对id进行判断，确保是正确的玩家进行的操作
-    std::vector<std::vector<Card*>> an_slot_card(const json& data, std::unordered_map<std::string, std::vector<Card*>> &player_cards_,
+    // slot_ids为player_action中每个栏位所出卡牌的编号（slots[i][j].id），由上行解析器给出
+    std::vector<std::vector<Card*>> an_slot_card(const std::vector<std::vector<int>>& slot_ids, std::unordered_map<std::string, std::vector<Card*>> &player_cards_,
         CardRandomizer &cardRandomizer,int &card_id,std::string &player_idnex,int &player_bones,
         std::vector<std::vector<Card*>> &slots_cards){
         // int out_card_num=0;
@@ -209,15 +216,12 @@ public:
         
 
         // 解析 slots 数据
-        if (data.contains("slots") && data["slots"].is_array()) {
-            // 调试输出：打印整个 slots 数据
-            // std::cout << "Slots data: " << data["slots"].dump(2) << std::endl;
-            
-            for (const auto& slot_data : data["slots"]) { // data["slots"]中含有四个slot_data
+        {
+            for (const auto& slot_data : slot_ids) { // slots中含有四个slot_data
                 std::vector<Card*> slot_cards;
                 
-                for (const auto& card_data : slot_data) { // slot_data中包含多个card_data
-                    card_id = card_data["id"].get<int>();
+                for (int card_data_id : slot_data) { // slot_data中包含多个card_data
+                    card_id = card_data_id;
 
                     // 在 player_cards_[player_id] 中查找并删除匹配的卡牌
                     auto& player_cards = player_cards_[player_idnex];
@@ -231,7 +235,7 @@ public:
                             if(costit!=nullptr&&state!=1){//state!=1表示卡牌原本不在场上，用来防止已上场的牌反复扣除资源
                                 std::string cost_name=costit->first;
                                 int cost_num=costit->second;
-                                if(costit->first=="骨头"){
+                                if((*it)->get_cost_resource()==protocol::CostResource::bone){
                                     if(player_bones>=costit->second){
                                         //可以出牌
                                         player_bones-=costit->second;
@@ -263,6 +267,18 @@ public:
         return slots_cards;
     }
 
+    // 热重启转存：跨回合保留的对战状态
+    json saveState() const {
+        return {{"iniflag", iniflag}, {"round", round}, {"character_HP", character_HP}, {"need_num", need_num}};
+    }
+
+    void restoreState(const json& state) {
+        iniflag = state.at("iniflag").get<int>();
+        round = state.at("round").get<int>();
+        character_HP = state.at("character_HP").get<int>();
+        need_num = state.at("need_num").get<int>();
+    }
+
 private:
     int iniflag=0;
     int round=0;
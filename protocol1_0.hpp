@@ -0,0 +1,124 @@
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+
+#include <cstdint>
+#include <string_view>
+
+// 协议中的枚举类字段：上行消息类型、card_placement_update的action、special_action的action_type和卡牌花费资源
+// 新增消息类型或取值只需在下面对应的列表中加一行，枚举、名字表和查找表都由列表生成
+// 解析时按FNV-1a哈希查表得到枚举，之后的分发全部是switch，不再比较字符串
+
+// 上行消息类型
+#define XEMK_MESSAGE_TYPES(X)                          \
+    X(player_join, "player_join")                      \
+    X(board_ack, "board_ack")                          \
+    X(card_placement_update, "card_placement_update")  \
+    X(player_action, "player_action")                  \
+    X(start_new_round, "start_new_round")              \
+    X(special_action, "special_action")
+
+// card_placement_update的action
+#define XEMK_PLACEMENT_ACTIONS(X) \
+    X(add, "add")                 \
+    X(clear, "clear")
+
+// special_action的action_type：抽一张随机卡牌或一张松鼠
+#define XEMK_DRAW_KINDS(X)        \
+    X(creations, "creations")     \
+    X(squirrels, "squirrels")
+
+// 卡牌花费的资源
+#define XEMK_COST_RESOURCES(X) \
+    X(blood, "血滴")           \
+    X(bone, "骨头")
+
+namespace protocol {
+
+constexpr uint32_t fnv1a(std::string_view s) {
+    uint32_t hash = 2166136261u;
+    for (char c : s) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+template <typename Enum>
+struct Entry {
+    std::string_view name;
+    uint32_t hash;
+    Enum value;
+};
+
+// 编译期检查同一张表内没有哈希冲突
+template <typename Enum, size_t N>
+constexpr bool collision_free(const Entry<Enum> (&table)[N]) {
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = i + 1; j < N; ++j) {
+            if (table[i].hash == table[j].hash) return false;
+        }
+    }
+    return true;
+}
+
+// 哈希命中后再核对一次字节，防止未注册的字符串恰好撞上某个哈希值
+template <typename Enum, size_t N>
+constexpr Enum lookup(const Entry<Enum> (&table)[N], std::string_view s, Enum fallback) {
+    uint32_t hash = fnv1a(s);
+    for (const auto& entry : table) {
+        if (entry.hash == hash) return entry.name == s ? entry.value : fallback;
+    }
+    return fallback;
+}
+
+template <typename Enum, size_t N>
+constexpr std::string_view name_of(const Entry<Enum> (&table)[N], Enum value) {
+    for (const auto& entry : table) {
+        if (entry.value == value) return entry.name;
+    }
+    return "unknown";
+}
+
+#define XEMK_ENUM_VALUE(id, text) id,
+#define XEMK_TABLE_ENTRY(Enum, id, text) {text, fnv1a(text), Enum::id},
+
+enum class MessageType : uint8_t { unknown, XEMK_MESSAGE_TYPES(XEMK_ENUM_VALUE) };
+enum class PlacementAction : uint8_t { unknown, XEMK_PLACEMENT_ACTIONS(XEMK_ENUM_VALUE) };
+enum class DrawKind : uint8_t { unknown, XEMK_DRAW_KINDS(XEMK_ENUM_VALUE) };
+enum class CostResource : uint8_t { unknown, XEMK_COST_RESOURCES(XEMK_ENUM_VALUE) };
+
+#define XEMK_MESSAGE_ENTRY(id, text) XEMK_TABLE_ENTRY(MessageType, id, text)
+#define XEMK_PLACEMENT_ENTRY(id, text) XEMK_TABLE_ENTRY(PlacementAction, id, text)
+#define XEMK_DRAW_ENTRY(id, text) XEMK_TABLE_ENTRY(DrawKind, id, text)
+#define XEMK_COST_ENTRY(id, text) XEMK_TABLE_ENTRY(CostResource, id, text)
+
+inline constexpr Entry<MessageType> kMessageTypes[] = {XEMK_MESSAGE_TYPES(XEMK_MESSAGE_ENTRY)};
+inline constexpr Entry<PlacementAction> kPlacementActions[] = {XEMK_PLACEMENT_ACTIONS(XEMK_PLACEMENT_ENTRY)};
+inline constexpr Entry<DrawKind> kDrawKinds[] = {XEMK_DRAW_KINDS(XEMK_DRAW_ENTRY)};
+inline constexpr Entry<CostResource> kCostResources[] = {XEMK_COST_RESOURCES(XEMK_COST_ENTRY)};
+
+#undef XEMK_MESSAGE_ENTRY
+#undef XEMK_PLACEMENT_ENTRY
+#undef XEMK_DRAW_ENTRY
+#undef XEMK_COST_ENTRY
+#undef XEMK_TABLE_ENTRY
+#undef XEMK_ENUM_VALUE
+
+static_assert(collision_free(kMessageTypes), "message type hash collision");
+static_assert(collision_free(kPlacementActions), "placement action hash collision");
+static_assert(collision_free(kDrawKinds), "draw kind hash collision");
+static_assert(collision_free(kCostResources), "cost resource hash collision");
+
+inline MessageType message_type(std::string_view s) { return lookup(kMessageTypes, s, MessageType::unknown); }
+inline PlacementAction placement_action(std::string_view s) { return lookup(kPlacementActions, s, PlacementAction::unknown); }
+inline DrawKind draw_kind(std::string_view s) { return lookup(kDrawKinds, s, DrawKind::unknown); }
+inline CostResource cost_resource(std::string_view s) { return lookup(kCostResources, s, CostResource::unknown); }
+
+inline std::string_view name_of(MessageType value) { return name_of(kMessageTypes, value); }
+
+static_assert(lookup(kMessageTypes, "player_action", MessageType::unknown) == MessageType::player_action,
+              "message type table lookup");
+
+} // namespace protocol
+
+#endif
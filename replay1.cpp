@@ -0,0 +1,42 @@
+
+#include "replay1_0.hpp"
+
+// 离线重放工具：replay1 <日志目录> [房间号...]
+// 不指定房间号时重放日志中的所有房间；任一房间与日志快照不一致时返回1
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <journal-dir> [room-id...]" << std::endl;
+        return 2;
+    }
+    try {
+        Logger::set_level(LogLevel::warn);
+        MatchReplay replay(argv[1]);
+        std::vector<std::string> rooms(argv + 2, argv + argc);
+        if (rooms.empty()) rooms = replay.rooms();
+
+        int failed = 0;
+        for (const auto& room_id : rooms) {
+            MatchReplay::Result result = replay.run(room_id);
+            if (!result.error.empty()) {
+                std::cout << room_id << ": " << result.error << std::endl;
+                ++failed;
+                continue;
+            }
+            std::cout << room_id << ": seed=" << result.seed << " commands=" << result.commands
+                      << " checked=" << result.checked << " mismatches=" << result.mismatches
+                      << " elapsed=" << result.elapsed_us << "us"
+                      << " slowest=" << result.slowest_op << "@" << result.slowest_seq << " "
+                      << result.slowest_us << "us" << std::endl;
+            if (result.mismatches > 0) {
+                std::cout << "  first mismatch at seq " << result.first_mismatch_seq << ": "
+                          << result.first_mismatch.dump() << std::endl;
+                ++failed;
+            }
+            std::cout << "  final state: " << result.final_state.dump() << std::endl;
+        }
+        return failed > 0 ? 1 : 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
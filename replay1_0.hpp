@@ -0,0 +1,137 @@
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "server1_8.hpp"
+
+// 离线重放：读入命令日志目录，在不联网的房间里从每个房间最早的快照起重新执行其后全部命令
+//  - 快照中带有对局种子和随机数状态，命令经由房间原有的处理路径（an_slot_card、cur_plays等）执行，结果应与线上一致
+//  - 每执行到日志中另有快照的序号，就把重放出的状态与该快照比较，第一处不一致即复现了线上的非确定性问题
+//  - 同时记录每条命令的执行时间，最慢的命令用于离线分析线上的慢回合
+class MatchReplay {
+public:
+    struct Result {
+        std::string room;
+        uint64_t seed = 0;
+        size_t commands = 0;            // 重放执行的命令数
+        size_t checked = 0;             // 与日志快照比较的次数
+        size_t mismatches = 0;
+        uint64_t first_mismatch_seq = 0;
+        json first_mismatch;            // 第一处不一致：日志快照到重放状态的JSON Patch
+        uint64_t slowest_seq = 0;
+        std::string slowest_op;
+        int64_t slowest_us = 0;
+        int64_t elapsed_us = 0;
+        json final_state;
+        std::string error;              // 无法重放时的原因
+    };
+
+    // 读入dir下所有日志段；房间被回收后又以同一房间号新开时只保留最近的一局
+    explicit MatchReplay(const std::string& dir) {
+        for (const auto& segment : Journal::list_segments(dir)) {
+            Journal::read_segment(segment.path, [this](const json& record) {
+                std::string room_id = record.value("room", std::string());
+                if (room_id.empty()) return;
+                History& history = histories_[room_id];
+                if (record.contains("snapshot")) {
+                    if (history.closed) history = History();
+                    history.snapshots.push_back(record);
+                } else if (record.contains("cmd")) {
+                    if (!history.closed) history.commands.push_back(record);
+                } else if (record.contains("closed")) {
+                    history.closed = true;
+                }
+            });
+        }
+    }
+
+    std::vector<std::string> rooms() const {
+        std::vector<std::string> ids;
+        for (const auto& [id, history] : histories_) ids.push_back(id);
+        return ids;
+    }
+
+    Result run(const std::string& room_id) {
+        Result result;
+        result.room = room_id;
+        auto it = histories_.find(room_id);
+        if (it == histories_.end() || it->second.snapshots.empty()) {
+            result.error = "no snapshot in journal";
+            return result;
+        }
+        const History& history = it->second;
+        const json& base = history.snapshots.front();
+        if (base.value("catalog", std::string()) != CardCatalog::shared().version()) {
+            result.error = "card catalog changed since the journal was written";
+            return result;
+        }
+        uint64_t base_seq = base.at("seq").get<uint64_t>();
+        std::multimap<uint64_t, const json*> expected;
+        for (size_t i = 1; i < history.snapshots.size(); ++i) {
+            const json& snapshot = history.snapshots[i];
+            uint64_t seq = snapshot.at("seq").get<uint64_t>();
+            if (seq > base_seq) expected.emplace(seq, &snapshot.at("snapshot"));
+        }
+        std::map<uint64_t, std::string> ops;
+        for (const auto& record : history.commands) {
+            ops[record.at("seq").get<uint64_t>()] = record.at("cmd").value("op", std::string());
+        }
+
+        // 房间只需要一个不监听的服务器对象和不运行的io_service：下行消息找不到连接直接丢弃，计时器不会触发
+        server endpoint;
+        websocketpp::lib::asio::io_service executor;
+        EventBus events;
+        MetricsRegistry registry;
+        GameMetrics metrics(registry);
+        TimerService timers;
+        RoomContext context{events, metrics, timers, RoomTimeouts()};
+        result.seed = base.at("snapshot").value("seed", uint64_t(0));
+        auto room = std::make_shared<GameRoom>(room_id, endpoint, executor, context, result.seed);
+
+        auto started = std::chrono::steady_clock::now();
+        auto last = started;
+        room->replay(base.at("snapshot"), history.commands, [&](uint64_t seq) {
+            auto now = std::chrono::steady_clock::now();
+            int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(now - last).count();
+            if (us > result.slowest_us) {
+                result.slowest_us = us;
+                result.slowest_seq = seq;
+                result.slowest_op = ops[seq];
+            }
+            ++result.commands;
+            auto range = expected.equal_range(seq);
+            if (range.first != range.second) {
+                json actual = room->snapshot();
+                for (auto e = range.first; e != range.second; ++e) {
+                    ++result.checked;
+                    if (*e->second == actual) continue;
+                    if (result.mismatches++ == 0) {
+                        result.first_mismatch_seq = seq;
+                        result.first_mismatch = json::diff(*e->second, actual);
+                    }
+                }
+            }
+            last = std::chrono::steady_clock::now();
+        });
+        result.elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - started).count();
+        result.final_state = room->snapshot();
+        return result;
+    }
+
+private:
+    struct History {
+        std::vector<json> snapshots;
+        std::vector<json> commands;
+        bool closed = false;
+    };
+
+    std::map<std::string, History> histories_;
+};
+
+#endif
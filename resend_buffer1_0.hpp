@@ -0,0 +1,64 @@
+#ifndef RESEND_BUFFER_HPP
+#define RESEND_BUFFER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "wire_codec1_0.hpp"
+
+// 一条已编号的下行消息，text为按codec编码好的完整帧（JSON文本或CBOR/MessagePack字节）
+struct OutboundMessage {
+    uint64_t seq = 0;
+    std::string type;
+    std::string text;
+    WireCodec codec = WireCodec::json;
+};
+
+// 每个座位一个的定长环形缓冲区，保存最近发出的下行消息
+// 断线重连时客户端带上最后确认的序号，缺口仍在缓冲区内就只补发缺口，否则由房间改发状态快照
+class ResendBuffer {
+public:
+    static constexpr size_t kDefaultCapacity = 256;
+
+    explicit ResendBuffer(size_t capacity = kDefaultCapacity) : ring_(capacity) {}
+
+    uint64_t last_seq() const { return last_seq_; }
+
+    uint64_t next_seq() const { return last_seq_ + 1; }
+
+    // 缓冲区中最早一条消息的序号，为空时返回next_seq()
+    uint64_t first_seq() const {
+        return last_seq_ - size_ + 1;
+    }
+
+    // 热重启后从last_seq继续编号，缓冲区为空：客户端已收到last_seq时无需补发，否则由房间发送状态快照
+    void resume_after(uint64_t last_seq) {
+        last_seq_ = last_seq;
+        size_ = 0;
+        for (auto& message : ring_) message.reset();
+    }
+
+    void record(std::shared_ptr<const OutboundMessage> message) {
+        last_seq_ = message->seq;
+        ring_[last_seq_ % ring_.size()] = std::move(message);
+        if (size_ < ring_.size()) ++size_;
+    }
+
+    // after_seq之后的消息全部还在缓冲区中时按顺序取出并返回true，缺口过大返回false
+    bool collect_after(uint64_t after_seq, std::vector<std::shared_ptr<const OutboundMessage>>& out) const {
+        if (after_seq > last_seq_) return false;
+        if (after_seq + 1 < first_seq()) return false;
+        for (uint64_t seq = after_seq + 1; seq <= last_seq_; ++seq) {
+            out.push_back(ring_[seq % ring_.size()]);
+        }
+        return true;
+    }
+
+private:
+    std::vector<std::shared_ptr<const OutboundMessage>> ring_;
+    uint64_t last_seq_ = 0;
+    size_t size_ = 0;
+};
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef ROOM_STATE_HPP
+#define ROOM_STATE_HPP
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "card3_5.hpp"
+
+// 热重启时的房间状态转存
+// 旧进程排空时把各房间的对局状态写成一个JSON文件，新进程启动时读入并重建房间，玩家带room_id重连即可继续对局
+// 卡牌以目录定义编号保存，目录版本不一致时定义编号不可信，整个文件作废
+namespace room_state {
+
+constexpr int kFormatVersion = 1;
+
+// 卡牌表：房间内同一张卡牌可能同时出现在手牌和场上栏位中，保存时按指针编号，恢复时按编号共享同一个对象
+class CardTable {
+public:
+    // 保存：返回卡牌在表中的编号，空指针为-1
+    int index_of(const Card* card) {
+        if (!card) return -1;
+        auto it = indices_.find(card);
+        if (it != indices_.end()) return it->second;
+        int index = static_cast<int>(states_.size());
+        indices_.emplace(card, index);
+        states_.push_back(card->saveState());
+        return index;
+    }
+
+    nlohmann::json ids(const std::vector<Card*>& cards) {
+        nlohmann::json out = nlohmann::json::array();
+        for (auto card : cards) out.push_back(index_of(card));
+        return out;
+    }
+
+    nlohmann::json ids(const std::vector<std::vector<Card*>>& slots) {
+        nlohmann::json out = nlohmann::json::array();
+        for (const auto& slot : slots) out.push_back(ids(slot));
+        return out;
+    }
+
+    nlohmann::json states() const { return states_; }
+
+    // 恢复：按保存的状态重建全部卡牌，之后按编号取用
+    void rebuild(const nlohmann::json& states, CardRandomizer& randomizer) {
+        cards_.clear();
+        for (const auto& state : states) {
+            cards_.push_back(randomizer.restoreCard(state));
+        }
+    }
+
+    Card* card(int index) const {
+        if (index < 0 || index >= static_cast<int>(cards_.size())) return nullptr;
+        return cards_[index];
+    }
+
+    std::vector<Card*> cards(const nlohmann::json& ids) const {
+        std::vector<Card*> out;
+        for (const auto& id : ids) out.push_back(card(id.get<int>()));
+        return out;
+    }
+
+    std::vector<std::vector<Card*>> slots(const nlohmann::json& ids) const {
+        std::vector<std::vector<Card*>> out;
+        for (const auto& slot : ids) out.push_back(cards(slot));
+        return out;
+    }
+
+private:
+    std::unordered_map<const Card*, int> indices_;
+    nlohmann::json states_ = nlohmann::json::array();
+    std::vector<Card*> cards_;
+};
+
+// 先写临时文件并fsync，再rename覆盖，读到的文件要么是旧的完整内容，要么是新的完整内容
+inline bool write_file(const std::string& path, const std::string& data, std::string& error) {
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = "open " + tmp + ": " + std::strerror(errno);
+        return false;
+    }
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            error = "write " + tmp + ": " + std::strerror(errno);
+            ::close(fd);
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    if (::fsync(fd) != 0) {
+        error = "fsync " + tmp + ": " + std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    ::close(fd);
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        error = "rename " + tmp + ": " + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+// 文件不存在时返回false且error为空
+inline bool read_file(const std::string& path, std::string& data, std::string& error) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        if (errno != ENOENT) error = "open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    char buffer[65536];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.append(buffer, n);
+    }
+    bool ok = !std::ferror(file);
+    std::fclose(file);
+    if (!ok) error = "read " + path + " failed";
+    return ok;
+}
+
+} // namespace room_state
+
+#endif
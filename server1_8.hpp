@@ -3,6 +3,8 @@
 #include <memory>
 #include <random>
 #include <set>
+#include <map>
+#include <sstream>
 #include <unordered_map>
 #include <unordered_set>
 #include <thread>
@@ -12,38 +14,257 @@
 #include <string>
 #include <atomic>
 #include <algorithm> 
+#include <array>
+#include <iterator>
+#include <cctype>
+#include <charconv>
+#include <future>
+#include <sys/socket.h>
 #include <websocketpp/config/asio_no_tls.hpp>
 #include <websocketpp/server.hpp>
+#include <websocketpp/common/asio.hpp>
 #include <nlohmann/json.hpp>
 #include "card3_5.hpp"
 #include "play3_5.hpp"
+#include "matchmaker1_0.hpp"
+#include "shard1_0.hpp"
+#include "resend_buffer1_0.hpp"
+#include "outbound_queue1_0.hpp"
+#include "board_sync1_0.hpp"
+#include "deflate1_0.hpp"
+#include "inbound1_0.hpp"
+#include "logger1_0.hpp"
+#include "event_bus1_0.hpp"
+#include "metrics1_0.hpp"
+#include "trace1_0.hpp"
+#include "timing_wheel1_0.hpp"
+#include "room_state1_0.hpp"
+#include "journal1_0.hpp"
+#include <optional>
 
 using namespace std::chrono_literals;
 using json = nlohmann::json;
 using std::placeholders::_1;
 using std::placeholders::_2;
 
-typedef websocketpp::server<websocketpp::config::asio> server;
+class GameRoom;
+
+// player_join中客户端声明的能力和重连信息
+struct JoinOptions {
+    std::optional<uint64_t> last_seq; // 重连时最后确认的下行消息序号
+    bool batch = false;               // 接受turn_commit合并帧
+    bool delta = false;               // 棋盘以board增量下发，客户端用board_ack确认
+    bool compact_cards = false;       // 卡牌只带目录定义编号和可变字段
+    std::string catalog_version;      // 客户端已缓存的卡牌目录版本，与服务器一致时不再下发card_catalog
+    std::string reconnect_token;      // 入座时room_joined中下发的令牌，接管已占用的座位时必须带上
+    WireCodec codec = WireCodec::json; // 由连接握手时协商的子协议决定，不从消息中读取
+
+    static JoinOptions from_message(const InboundMessage& data) {
+        JoinOptions options;
+        options.last_seq = data.last_seq;
+        options.batch = data.batch;
+        options.delta = data.delta;
+        options.compact_cards = data.compact_cards;
+        options.catalog_version = data.catalog_version;
+        options.reconnect_token = data.reconnect_token;
+        return options;
+    }
+};
+
+// 排队中的玩家，附带加入时声明的能力
+struct PlayerTicket : MatchTicket {
+    JoinOptions options;
+};
+
+// 连接所在的房间和座位
+struct SeatBinding {
+    std::shared_ptr<GameRoom> room;
+    std::string seat;
+};
+
+// 自定义websocketpp配置：每个连接对象上直接挂载所属房间和座位，消息路由不再查全局表、不再加全局锁
+// binding可能由匹配线程写入，统一用std::atomic_load/atomic_store/atomic_exchange访问
+struct game_config : public websocketpp::config::asio {
+    typedef game_config type;
+    // 客户端在握手中请求permessage-deflate时启用压缩，参数见TunedDeflate::settings()
+    typedef TunedDeflate permessage_deflate_type;
+
+    struct connection_base {
+        std::shared_ptr<SeatBinding> binding;
+        std::shared_ptr<MatchTicket> ticket; // 排队中的匹配请求，匹配线程也会读取，用atomic_load/atomic_exchange访问
+        OutboundQueue outbound;              // 下行队列，带字节预算和优先级
+        std::atomic<bool> flush_scheduled{false};
+        WireCodec codec = WireCodec::json;   // 握手时协商，之后只读
+        // 心跳，时间均为steady_clock微秒：最近一次收到消息或pong、尚未回应的ping的发出时间（0表示没有）、
+        // 连续未回应的ping数、最近一次往返时间（-1表示尚未测得，按座位导出为xemk_player_rtt_seconds）。只做relaxed读写
+        std::atomic<int64_t> last_seen_us{0};
+        std::atomic<int64_t> ping_sent_us{0};
+        std::atomic<int> missed_pongs{0};
+        std::atomic<int64_t> rtt_us{-1};
+    };
+};
+
+typedef websocketpp::server<game_config> server;
+
 
 //初步实现功能，需要完善显示界面
 
-// 自定义日志函数替代ROS的日志
-class Logger {
-public:
-    static void info(const std::string& message) {
-        std::cout << "[INFO] " << message << std::endl;
+// 房间计时：轮到的玩家超时未出牌时自动跳过，连续跳过afk_forfeit_passes次判负；
+// 对局中断线超过重连宽限判负；一方请求新一局后另一方超时未确认则取消请求。各项为0表示不启用
+struct RoomTimeouts {
+    std::chrono::milliseconds turn{60000};
+    std::chrono::milliseconds reconnect_grace{60000};
+    std::chrono::milliseconds new_round{30000};
+    int afk_forfeit_passes = 3;
+};
+
+// 服务器启动参数
+struct ServerConfig {
+    uint16_t port = 8002;
+    // 运行同一个io_context的I/O线程数，0表示取CPU核数
+    size_t io_threads = 0;
+    // 分片数，0表示房间直接在I/O线程池上按strand执行；大于0时房间按房间号哈希到独立的分片线程
+    size_t shards = 0;
+    // 分片线程是否绑核
+    bool pin_cpus = true;
+    // 多进程部署：工作进程数（大于1时所有进程以SO_REUSEPORT共享port）和本进程编号
+    size_t workers = 1;
+    size_t worker_index = 0;
+    // 第i个工作进程额外独占监听 route_port_base+i，房间不属于本进程时把客户端重定向过去，0表示port+1
+    uint16_t route_port_base = 0;
+    // 每个连接下行队列的字节预算，超出后断开慢连接
+    size_t outbound_budget_bytes = 256 * 1024;
+    // permessage-deflate：是否接受客户端的压缩请求、压缩窗口位数、zlib memLevel和压缩级别、最小压缩字节数
+    bool deflate = true;
+    int deflate_window_bits = 15;
+    int deflate_mem_level = 8;
+    int deflate_level = -1;
+    size_t deflate_min_size = 256;
+    // 上行消息的最大字节数，websocketpp按帧头中的长度直接拒绝超出的帧（关闭码1009），不缓存其内容
+    size_t max_message_bytes = 64 * 1024;
+    // 运行期日志级别：debug、info、warn、error或off
+    LogLevel log_level = LogLevel::info;
+    // 从收到帧到处理完成超过该毫秒数的消息写入慢回合日志，0表示关闭
+    uint64_t slow_turn_ms = 20;
+    std::string slow_turn_log = "slow_turns.log";
+    // 房间计时（毫秒），见RoomTimeouts
+    uint64_t turn_timeout_ms = 60000;
+    uint64_t reconnect_grace_ms = 60000;
+    uint64_t new_round_timeout_ms = 30000;
+    int afk_forfeit_passes = 3;
+    // 服务器心跳：每隔ping_interval_ms向每个连接发一次ping，连续max_missed_pongs次没有回应（期间也没有收到消息）的连接被关闭。
+    // 0表示不发心跳
+    uint64_t ping_interval_ms = 15000;
+    int max_missed_pongs = 3;
+    // 热重启：收到SIGTERM/SIGINT时把进行中的房间转存到state_file，启动时从该文件恢复，空字符串表示不转存；
+    // 转存后最多等待drain_timeout_ms让关闭握手完成
+    std::string state_file = "room_state.json";
+    uint64_t drain_timeout_ms = 3000;
+    // 崩溃恢复日志：房间命令按journal_commit_us组提交落盘，段超过journal_segment_mb后换段；
+    // 房间每snapshot_every条命令写一次快照。空目录表示不写日志
+    std::string journal_dir = "journal";
+    uint64_t journal_commit_us = 2000;
+    uint64_t journal_segment_mb = 64;
+    int snapshot_every = 64;
+    // 非0时各房间的对局种子由它和房间号派生，同一命令序列可在另一进程中得到同一局面；0表示每个房间取随机种子
+    uint64_t seed = 0;
+
+    RoomTimeouts room_timeouts() const {
+        RoomTimeouts timeouts;
+        timeouts.turn = std::chrono::milliseconds(turn_timeout_ms);
+        timeouts.reconnect_grace = std::chrono::milliseconds(reconnect_grace_ms);
+        timeouts.new_round = std::chrono::milliseconds(new_round_timeout_ms);
+        timeouts.afk_forfeit_passes = afk_forfeit_passes;
+        return timeouts;
     }
-    
-    static void error(const std::string& message) {
-        std::cout << "[ERROR] " << message << std::endl;
+
+    // 多进程部署时每个工作进程转存自己的房间
+    std::string state_path() const {
+        if (state_file.empty() || workers <= 1) return state_file;
+        return state_file + ".w" + std::to_string(worker_index);
     }
-};
 
-// 替代ROS发布器的简单类
-class SimplePublisher {
-public:
-    void publish(const std::string& message, const std::string& topic) {
-        Logger::info("Published to " + topic + ": " + message);
+    std::string journal_path() const {
+        if (journal_dir.empty() || workers <= 1) return journal_dir;
+        return journal_dir + ".w" + std::to_string(worker_index);
+    }
+
+    uint16_t route_port(size_t worker) const {
+        uint16_t base = route_port_base != 0 ? route_port_base : static_cast<uint16_t>(port + 1);
+        return static_cast<uint16_t>(base + worker);
+    }
+
+    // 解析 --port=8002 --io-threads=8 形式的命令行参数
+    static ServerConfig from_args(int argc, char* argv[]) {
+        ServerConfig config;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            auto value_of = [&](const std::string& key) -> const char* {
+                return arg.compare(0, key.size(), key) == 0 ? arg.c_str() + key.size() : nullptr;
+            };
+            if (auto v = value_of("--port=")) {
+                config.port = static_cast<uint16_t>(std::stoi(v));
+            } else if (auto v = value_of("--io-threads=")) {
+                config.io_threads = static_cast<size_t>(std::stoul(v));
+            } else if (auto v = value_of("--shards=")) {
+                config.shards = static_cast<size_t>(std::stoul(v));
+            } else if (arg == "--no-pin-cpus") {
+                config.pin_cpus = false;
+            } else if (auto v = value_of("--workers=")) {
+                config.workers = std::max<size_t>(1, std::stoul(v));
+            } else if (auto v = value_of("--outbound-budget=")) {
+                config.outbound_budget_bytes = static_cast<size_t>(std::stoul(v));
+            } else if (auto v = value_of("--route-port-base=")) {
+                config.route_port_base = static_cast<uint16_t>(std::stoi(v));
+            } else if (arg == "--no-deflate") {
+                config.deflate = false;
+            } else if (auto v = value_of("--deflate-window-bits=")) {
+                config.deflate_window_bits = std::stoi(v);
+            } else if (auto v = value_of("--deflate-mem-level=")) {
+                config.deflate_mem_level = std::stoi(v);
+            } else if (auto v = value_of("--deflate-level=")) {
+                config.deflate_level = std::stoi(v);
+            } else if (auto v = value_of("--deflate-min-size=")) {
+                config.deflate_min_size = static_cast<size_t>(std::stoul(v));
+            } else if (auto v = value_of("--max-message-bytes=")) {
+                config.max_message_bytes = static_cast<size_t>(std::stoul(v));
+            } else if (auto v = value_of("--slow-turn-ms=")) {
+                config.slow_turn_ms = std::stoull(v);
+            } else if (auto v = value_of("--slow-turn-log=")) {
+                config.slow_turn_log = v;
+            } else if (auto v = value_of("--turn-timeout-ms=")) {
+                config.turn_timeout_ms = std::stoull(v);
+            } else if (auto v = value_of("--reconnect-grace-ms=")) {
+                config.reconnect_grace_ms = std::stoull(v);
+            } else if (auto v = value_of("--new-round-timeout-ms=")) {
+                config.new_round_timeout_ms = std::stoull(v);
+            } else if (auto v = value_of("--afk-forfeit-passes=")) {
+                config.afk_forfeit_passes = std::stoi(v);
+            } else if (auto v = value_of("--ping-interval-ms=")) {
+                config.ping_interval_ms = std::stoull(v);
+            } else if (auto v = value_of("--max-missed-pongs=")) {
+                config.max_missed_pongs = std::max(1, std::stoi(v));
+            } else if (auto v = value_of("--state-file=")) {
+                config.state_file = v;
+            } else if (auto v = value_of("--drain-timeout-ms=")) {
+                config.drain_timeout_ms = std::stoull(v);
+            } else if (auto v = value_of("--journal-dir=")) {
+                config.journal_dir = v;
+            } else if (auto v = value_of("--journal-commit-us=")) {
+                config.journal_commit_us = std::stoull(v);
+            } else if (auto v = value_of("--journal-segment-mb=")) {
+                config.journal_segment_mb = std::max<uint64_t>(1, std::stoull(v));
+            } else if (auto v = value_of("--snapshot-every=")) {
+                config.snapshot_every = std::max(1, std::stoi(v));
+            } else if (auto v = value_of("--seed=")) {
+                config.seed = std::stoull(v);
+            } else if (auto v = value_of("--log-level=")) {
+                config.log_level = Logger::parse_level(v);
+            } else {
+                Logger::error("Unknown argument: " + arg);
+            }
+        }
+        return config;
     }
 };
 
@@ -61,8 +282,154 @@ public:
 //      handle_player_action中需要补充玩家选择献祭场上卡牌的逻辑
 
 
-//1230,骨头的郊狼方第一栏过了一回合就没了，先手方每选卡片直接结束导致卡牌栏错位了
-class GameServer {
+// 房间和消息处理路径上的延迟直方图，由GameServer在启动时注册到自己的指标表，房间持有其引用
+// 记录只做几次relaxed原子加和两次steady_clock读取，可以常开
+struct GameMetrics {
+    // 处理流水线的各阶段：帧解析（I/O线程）、在房间strand上排队、出牌处理及其中的出牌解析和对战结算、回合合并下发
+    enum class Stage : uint8_t { parse, strand_wait, handle_player_action, an_slot_card, cur_plays, commit, count };
+
+    static constexpr size_t kMessageTypes = std::size(protocol::kMessageTypes) + 1;
+
+    std::array<LatencyHistogram*, kMessageTypes> message_seconds{};
+    std::array<LatencyHistogram*, static_cast<size_t>(Stage::count)> stage_seconds{};
+    Counter* frames_rejected = nullptr;
+    LatencyHistogram* rtt_seconds = nullptr;
+    Counter* heartbeat_reaped = nullptr;
+
+    explicit GameMetrics(MetricsRegistry& registry) {
+        for (size_t i = 0; i < kMessageTypes; ++i) {
+            auto type = static_cast<protocol::MessageType>(i);
+            message_seconds[i] = &registry.histogram(
+                "xemk_message_seconds", "Time spent handling an inbound message, by type.",
+                "type=\"" + std::string(protocol::name_of(type)) + "\"");
+        }
+        static const char* stage_names[] = {"parse", "strand_wait", "handle_player_action",
+                                            "an_slot_card", "cur_plays", "commit"};
+        for (size_t i = 0; i < stage_seconds.size(); ++i) {
+            stage_seconds[i] = &registry.histogram("xemk_stage_seconds", "Time spent in each message pipeline stage.",
+                                                   "stage=\"" + std::string(stage_names[i]) + "\"");
+        }
+        frames_rejected = &registry.counter("xemk_frames_rejected_total",
+                                            "Inbound frames dropped as malformed, oversized or of unknown type.");
+        rtt_seconds = &registry.histogram("xemk_rtt_seconds", "Round-trip time measured by server WebSocket pings.");
+        heartbeat_reaped = &registry.counter("xemk_heartbeat_reaped_total",
+                                             "Connections closed after missing consecutive pongs.");
+    }
+
+    LatencyHistogram* message(protocol::MessageType type) const {
+        return message_seconds[static_cast<size_t>(type)];
+    }
+
+    LatencyHistogram* stage(Stage stage) const {
+        return stage_seconds[static_cast<size_t>(stage)];
+    }
+};
+
+// 房间共用的服务器设施，由GameServer持有且比所有房间活得久
+struct RoomContext {
+    EventBus& events;
+    const GameMetrics& metrics;
+    TimerService& timers;
+    RoomTimeouts timeouts;
+    Journal* journal = nullptr; // 命令日志，未启用时为空
+};
+
+// 所有下行帧的统一出口：先进入连接自己的下行队列，再按websocketpp内部缓冲的水位下发
+// websocketpp缓冲满时由定时器稍后继续下发；慢连接超出预算或积压过久时被断开
+class FrameSender {
+public:
+    static constexpr auto kRetryInterval = std::chrono::milliseconds(10);
+
+    static void send(server& endpoint, websocketpp::connection_hdl hdl, std::shared_ptr<const OutboundMessage> message) {
+        websocketpp::lib::error_code ec;
+        server::connection_ptr con = endpoint.get_con_from_hdl(hdl, ec);
+        if (ec || !con) return;
+        if (con->outbound.push(std::move(message)) == OutboundQueue::PushResult::overflow) {
+            shed_connection(con);
+            return;
+        }
+        flush(endpoint, con);
+    }
+
+    // 不带序号的消息（加入结果、错误提示等），按连接协商的编码序列化
+    static void send(server& endpoint, websocketpp::connection_hdl hdl, const json& message) {
+        websocketpp::lib::error_code ec;
+        server::connection_ptr con = endpoint.get_con_from_hdl(hdl, ec);
+        if (ec || !con) return;
+        auto outbound = std::make_shared<OutboundMessage>();
+        outbound->type = message.value("type", std::string());
+        outbound->codec = con->codec;
+        outbound->text = wire::encode(con->codec, message);
+        send(endpoint, hdl, std::move(outbound));
+    }
+
+    // 本连接积压的总字节数：下行队列加上websocketpp内部缓冲
+    static size_t buffered_bytes(const server::connection_ptr& con) {
+        return con->outbound.buffered_bytes() + con->get_buffered_amount();
+    }
+
+private:
+    static void flush(server& endpoint, const server::connection_ptr& con) {
+        bool drained = con->outbound.flush(
+            [&con]() { return con->get_buffered_amount(); },
+            [&con](const OutboundMessage& message) {
+                auto opcode = wire::is_binary(con->codec) ? websocketpp::frame::opcode::binary
+                                                          : websocketpp::frame::opcode::text;
+                server::message_ptr frame;
+                if (message.codec == con->codec) {
+                    frame = con->get_message(opcode, message.text.size());
+                    frame->append_payload(message.text);
+                } else {
+                    // 换了编码重连后补发的旧消息
+                    std::string text = wire::transcode(message.codec, con->codec, message.text);
+                    frame = con->get_message(opcode, text.size());
+                    frame->append_payload(text);
+                }
+                // 小消息压缩收益不抵CPU开销；未协商permessage-deflate的连接忽略该标志
+                frame->set_compressed(frame->get_payload().size() >= TunedDeflate::settings().min_size);
+                CompressionStats::Scope scope(&CompressionStats::entry(message.type));
+                websocketpp::lib::error_code ec = con->send(frame);
+                if (ec) {
+                    LOG_ERROR("websocket send error", {{"error", ec.message()}, {"type", message.type}});
+                }
+            });
+        if (!drained) {
+            schedule_flush(endpoint, con);
+        }
+    }
+
+    static void schedule_flush(server& endpoint, const server::connection_ptr& con) {
+        if (con->flush_scheduled.exchange(true)) return;
+        auto timer = std::make_shared<websocketpp::lib::asio::steady_timer>(endpoint.get_io_service(), kRetryInterval);
+        websocketpp::connection_hdl hdl = con->get_handle();
+        timer->async_wait([&endpoint, hdl, timer](const auto& error) {
+            websocketpp::lib::error_code ec;
+            server::connection_ptr con = endpoint.get_con_from_hdl(hdl, ec);
+            if (ec || !con) return;
+            con->flush_scheduled.store(false);
+            if (error) return;
+            if (con->outbound.is_stalled()) {
+                shed_connection(con);
+                return;
+            }
+            flush(endpoint, con);
+        });
+    }
+
+    static void shed_connection(const server::connection_ptr& con) {
+        size_t pending = buffered_bytes(con);
+        con->outbound.clear();
+        OutboundQueue::global_stats().slow_disconnects.fetch_add(1, std::memory_order_relaxed);
+        LOG_WARN("closing slow consumer", {{"remote", con->get_remote_endpoint()}, {"pending_bytes", pending}});
+        websocketpp::lib::error_code ec;
+        con->close(websocketpp::close::status::policy_violation, "slow consumer", ec);
+    }
+};
+
+// 单局对战的全部状态，一个GameServer可同时承载多个房间，玩家以 房间号+座位("player1"/"player2") 定位
+// 房间的所有处理都通过post投递到房间自己的strand上串行执行，因此房间内部不需要加锁，不同房间之间互不阻塞
+// 按缓存行对齐，分片模式下不同分片的房间不会共享同一缓存行
+class alignas(kCacheLineSize) GameRoom : public std::enable_shared_from_this<GameRoom> {
 public:
     int flag = 0;//0开局标志
     int choosing_card = 0;
@@ -73,7 +440,6 @@ public:
     int card_id=0;
     int fist=0;
     
-    std::random_device rd;
     std::mt19937 gen;
     std::uniform_int_distribution<> dis;
 
@@ -81,269 +447,259 @@ public:
 
     CardRandomizer cardRandomizer;
     play game_play;
-    GameServer() : gen(rd()), dis(0, 1), last_player((dis(gen) == 0) ? "player1" : "player2") , slots_cards(4) {
-        // WebSocket服务器设置
-        ws_server_.init_asio();
-        ws_server_.set_open_handler(bind(&GameServer::on_open, this, ::_1));
-        ws_server_.set_close_handler(bind(&GameServer::on_close, this, ::_1));
-        ws_server_.set_message_handler(bind(&GameServer::on_message, this, ::_1, ::_2));
-        
-        ws_server_.listen(8002);
-        ws_server_.start_accept();
-        
-        // 在后台线程运行WebSocket服务器
-        ws_thread_ = std::thread([this]() {
-            ws_server_.run();
-        });
-        
-        
-        Logger::info("Game server started on port 8002");
+    // executor为房间执行所在的io_service：I/O线程池本身，或分片模式下该房间所属分片的io_service
+    // context为服务器的事件总线、延迟直方图、定时器和超时设置
+    // seed为对局种子：先手选择和抽牌都由它派生，同一种子加同一命令序列得到同一局面
+    GameRoom(const std::string& room_id, server& ws_server, websocketpp::lib::asio::io_service& executor,
+             const RoomContext& context, uint64_t seed)
+        : gen(seeded_engine(derive_seed(seed, 0))), dis(0, 1), last_player((dis(gen) == 0) ? "player1" : "player2"),
+          cardRandomizer(derive_seed(seed, 1)), seed_(seed),
+          room_id_(room_id), ws_server_(ws_server), strand_(executor), events_(context.events),
+          metrics_(context.metrics), timers_(context.timers), timeouts_(context.timeouts), journal_(context.journal),
+          slots_cards(4) {
+        game_play.on_card_death = [this](const std::string& owner, int slot, const Card& card, int bones) {
+            if (wants_event<DeathEvent>()) {
+                events_.publish(DeathEvent{room_id_, owner, card.getName(), card.get_play_current_card_id(), slot});
+            }
+            if (wants_event<BoneGainEvent>()) {
+                events_.publish(BoneGainEvent{room_id_, owner, 1, bones});
+            }
+        };
     }
-    
-    ~GameServer() {
-        running_ = false;
-        ws_server_.stop();
-        
-        if (ws_thread_.joinable()) {
-            ws_thread_.join();
-        }
-        
-        if (game_timer_thread_.joinable()) {
-            game_timer_thread_.join();
+
+    ~GameRoom() {
+        TimerService::cancel(turn_timer_);
+        TimerService::cancel(new_round_timer_);
+        for (auto& [seat, timer] : grace_timers_) {
+            TimerService::cancel(timer.handle);
         }
-    }
-private:
-    std::string get_connection_info(websocketpp::connection_hdl hdl, server& server) {
-        server::connection_ptr con = server.get_con_from_hdl(hdl);
-        if (!con) return "Invalid connection";
-        
-        std::ostringstream info;
-        info << "IP: " << con->get_remote_endpoint()
-            << ", Resource: " << con->get_resource()
-            << ", Host: " << con->get_host();
-        
-        // 检查是否有查询参数
-        std::string query = con->get_uri()->get_query();
-        if (!query.empty()) {
-            info << ", Query: " << query;
+        // 房间销毁时释放仍在手牌中的卡牌
+        for (auto& [pid, cards] : player_cards_) {
+            for (auto card : cards) {
+                delete card;
+            }
         }
-        
-        return info.str();
     }
-    void on_open(websocketpp::connection_hdl hdl) {
-        std::lock_guard<std::mutex> lock(connections_mutex_);
-        connections_.insert(hdl);
-        Logger::info("New client connected");
 
-        std::string info = get_connection_info(hdl, ws_server_);
-        Logger::info("New client connected - " + info);
+    const std::string& id() const { return room_id_; }
+    uint64_t seed() const { return seed_; }
+
+    // 投递到房间strand执行，房间状态只在strand上读写
+    template <typename Handler>
+    void post(Handler&& handler) {
+        strand_.post(std::forward<Handler>(handler));
     }
-    
-    void on_close(websocketpp::connection_hdl hdl) {
-        std::lock_guard<std::mutex> lock(connections_mutex_);
-        connections_.erase(hdl);
-        
-        // 检查是否是已注册的玩家断开连接
-        std::lock_guard<std::mutex> game_lock(game_mutex_);
-        std::string disconnected_player;
-        for (const auto& [player_id, player_hdl] : player_connections_) {
-            if (player_hdl.lock() == hdl.lock()) {
-                disconnected_player = player_id;
-                break;
+
+    // 慢回合记录：消息轨迹的span树加上处理结束时的房间状态，交给SlowTurnLog在后台写入
+    void report_slow_turn(const TurnTrace& trace, const std::string& seat, const InboundMessage& payload) {
+        json state;
+        state["flag"] = flag;
+        state["choosing_card"] = choosing_card;
+        state["round_flag"] = round_flag;
+        state["last_player"] = last_player;
+        state["player_hp"] = player_hp_;
+        state["bones"] = {{"first", last_player_bones}, {"second", cur_player_bones}};
+        for (const char* id : {"player1", "player2"}) {
+            json player;
+            player["connected"] = player_connections_.count(id) != 0 && disconnected_players_.count(id) == 0;
+            json hand = json::array();
+            auto hand_it = player_cards_.find(id);
+            if (hand_it != player_cards_.end()) {
+                for (auto card : hand_it->second) {
+                    if (card) hand.push_back(card->getName());
+                }
             }
+            player["hand"] = std::move(hand);
+            json board = json::array();
+            for (const auto& slot : board_of(id)) {
+                if (!slot.empty() && slot[0]) {
+                    board.push_back({{"card", slot[0]->getName()}, {"hp", slot[0]->getHP()}});
+                } else {
+                    board.push_back(nullptr);
+                }
+            }
+            player["board"] = std::move(board);
+            player["outbox_seq"] = outboxes_[id].next_seq();
+            state[id] = std::move(player);
         }
-        
-        if (!disconnected_player.empty()) {
-            // 标记玩家为断开状态，但不移除游戏数据
-            disconnected_players_.insert(disconnected_player);
-            Logger::info("Player " + disconnected_player + " disconnected");
-            
-            // 通知另一个玩家
-            notify_player_disconnected(disconnected_player);
-        }
-        
-        Logger::info("Client disconnected");
-    }
-    
-    void on_message(websocketpp::connection_hdl hdl, server::message_ptr msg) {
-        try {
-            auto payload = json::parse(msg->get_payload());
-            std::string type = payload["type"];
-            
-            player_idnex = payload["player_id"];
 
-            if(player_idnex=="player1")  player_idnex_op="player2";
-            else player_idnex_op="player1";
-            //card_placement_update
-            
-            // if(choosing_card==1&&type=="special_action"&&flag>0)
-            if(choosing_card==1&&type=="special_action")
-            {
-                std::string action_type = payload["action_type"];
-                generate_unique_numbers(player_idnex, action_type);
-                if(flag==2) flag=0;
+        int64_t elapsed_us = trace.elapsed_us();
+        std::string record = "=== slow turn room=" + room_id_ + " seat=" + seat + " type=" + payload.type +
+                             " total=" + std::to_string(elapsed_us) + "us\n";
+        record += trace.render();
+        record += "state " + state.dump() + "\n";
+        SlowTurnLog::shared().submit(std::move(record));
+        LOG_WARN("slow turn", {{"room", room_id_}, {"seat", seat}, {"type", payload.type}, {"total_us", elapsed_us}});
+    }
 
-                // 立即发送新卡牌
-                send_cards_to_player(player_idnex);
-                
-                choosing_card=0;
-            }else if(choosing_card==0){
-                if (type == "player_join") {
-                    handle_player_join(hdl, payload);
-                } else if (type == "card_placement_update") {//收到场上卡牌更新消息
-                    if(player_idnex!=last_player){
-                        //payload["action"]有"clear"和"add"两种，需要一个总的计数xianjiing，"clear"-1,"add"+1
-                        //同时当"add"的卡牌需要献祭时，需要确保总的计数最终为原计数-血滴数
-                        int xj_card_id=payload["card"]["card_id"];
-                        if(payload["action"]=="clear"){
-                            for(auto &&it=player_cards_[player_idnex].begin();it!=player_cards_[player_idnex].end();it++){
-                                if((*it)->get_play_current_card_id()==xj_card_id){
-                                    if((*it)->get_card_state()==1){
-                                        xianjiing+=1;
+    // 热重启：在strand上转存对局状态并冻结房间，之前已投递的消息都已处理完，之后的消息和计时器一律忽略
+    // 在线玩家收到server_restart后连接被关闭，客户端带room_id和last_seq重连到新进程
+    // 没有玩家入座的房间返回null
+    json suspend() {
+        frozen_ = true;
+        TimerService::cancel(turn_timer_);
+        TimerService::cancel(new_round_timer_);
+        for (auto& [seat, timer] : grace_timers_) {
+            TimerService::cancel(timer.handle);
+        }
+        if (player_connections_.empty()) return nullptr;
+        json state = save_state();
 
-                                        if(flag==0){//第一个玩家回合结束前
-                                            last_player_bones+=1;
-                                            // slots_cards=last_slots_cards[player_idnex];
-                                        }else if(flag==1){//第二个玩家回合结束前
-                                            cur_player_bones+=1;
-                                            // slots_cards=cur_player_slots_cards[player_idnex];
-                                        }
+        json notice;
+        notice["type"] = "server_restart";
+        notice["room_id"] = room_id_;
+        notice["message"] = "Server restarting, reconnect to resume the match";
+        for (const auto& [seat, hdl] : player_connections_) {
+            if (disconnected_players_.count(seat)) continue;
+            // 不带seq，不计入重发缓冲区，保证转存的last_seq就是客户端应当确认到的位置
+            send_to_connection(hdl, notice);
+            websocketpp::lib::error_code ec;
+            ws_server_.close(hdl, websocketpp::close::status::going_away, "server restarting", ec);
+        }
+        return state;
+    }
 
-                                        (*it)->set_card_state(0);
-                                        // delete *it;
-                                        it=player_cards_[player_idnex].erase(it);
-
-                                        //如果去掉会导致第一回合出场后的松鼠被献祭后回到手牌，但实际不存在了，需要通知玩家前端当前手牌去掉该松鼠
-                                        //当前出现在第一回合结束后，新打出一张牌并之后献祭原有的牌时会导致两张牌都丢失。
-                                        // if(round_flag==2&&adding==0){
-                                        if(adding==0){
-                                            if(flag==0){//第一个玩家回合结束前
-                                                // last_slots_cards[player_idnex].pop_back(it);
-                                                process_player_move(player_idnex, last_slots_cards[player_idnex]);
-                                            }else if(flag==1){//第二个玩家回合结束前
-                                            
-                                                process_player_move(player_idnex, cur_player_slots_cards[player_idnex]);
-                                            }
-                                        }
-                                        break;
-                                    }else{
-                                        break;
-                                    }
-                                }
-                            }
-                            
-                        } else if(payload["action"]=="add"){
-                            if(payload["card"]["cost"].size()>0){
-                                // std::string cost = payload["card"]["cost"];
-                                std::string resource = payload["card"]["cost"][0]["resource"];
-                                if(resource=="血滴"){
-                                    int cost_num=payload["card"]["cost"][0]["amount"];
-                                    if(xianjiing>=cost_num){
-                                        for(auto &&it=player_cards_[player_idnex].begin();it!=player_cards_[player_idnex].end();it++){
-                                            if((*it)->get_play_current_card_id()==xj_card_id){
-                                                (*it)->set_card_state(1);
-                                                xianjiing-=cost_num;
-                                                break;
-                                            }
-                                        }
-                                    }
-                                }
-                            }else{
-                                for(auto &&it=player_cards_[player_idnex].begin();it!=player_cards_[player_idnex].end();it++){
-                                    if((*it)->get_play_current_card_id()==xj_card_id){
-                                        (*it)->set_card_state(1);
-                                        adding=1;
-                                        if(flag==0){
+    // 新进程启动时在strand上恢复suspend()转存的状态，两个座位都视为断线等待重连
+    void restore(const json& state) {
+        load_state(state);
+        resume_after_restart();
+        checkpoint();
+    }
 
-                                        }
-                                        break;
-                                    }
-                                }
-                            }
-                            
-                        }
-                        //将当前玩家的骨头数量发给前端
-                        player_bonus={cur_player_bones, last_player_bones};
-
-                        json bonus_response;
-                        bonus_response["type"] = "player_bonus";
-                        bonus_response["message"]=player_bonus;
-                        bonus_response["blood"]=xianjiing;
-                        send_to_player(player_idnex, bonus_response.dump());
-
-                        json bonus_response_op;
-                        bonus_response_op["type"] = "player_bonus";
-                        bonus_response_op["message"]=player_bonus;
-                        send_to_player(player_idnex_op, bonus_response_op.dump());
-
-                    }else{
-                        adding=0;
-                    }
-                }
-                else if(type == "player_action") {
-                    std::string player_id = player_idnex;
-                    if (player_id == last_player) {
-                        Logger::info("received same player's action");
-                        // return;
-                    } else {
-                        if(round_flag<2) round_flag++;
-                        
-                        flag+=1;
-                        //需要补充玩家出的牌是否满足条件，即注意花费
-                        std::vector<std::vector<Card*>> slots_cards=handle_player_action(hdl, payload);   
-                        xianjiing=0;      
-                    }
-                    
-                } else if (type == "start_new_round") {
-                    handle_start_new_round(hdl, payload);
-                }
+    // 崩溃恢复：载入命令日志中最近的快照，依次重新执行其后的命令，之后同restore()
+    // 重放期间不发布事件、不安排计时器，产生的下行消息只进入各座位的重发缓冲区
+    // on_applied在每条命令执行后以其序号调用，供离线重放工具比对中间状态
+    void replay(const json& snapshot, const std::vector<json>& commands,
+                const std::function<void(uint64_t seq)>& on_applied = {}) {
+        replaying_ = true;
+        load_state(snapshot);
+        size_t applied = 0;
+        for (const auto& record : commands) {
+            uint64_t seq = record.at("seq").get<uint64_t>();
+            if (seq <= journal_seq_) continue;
+            if (seq != journal_seq_ + 1) {
+                LOG_WARN("journal gap, replay stopped", {{"room", room_id_}, {"expected", journal_seq_ + 1}, {"seq", seq}});
+                break;
             }
-            
-            
-        } catch (const std::exception& e) {
-            Logger::error("Error processing message: " + std::string(e.what()));
+            journal_seq_ = seq;
+            try {
+                apply(record.at("cmd"));
+            } catch (const std::exception& e) {
+                LOG_ERROR("journal command failed, replay stopped", {{"room", room_id_}, {"seq", seq}, {"error", e.what()}});
+                break;
+            }
+            ++applied;
+            if (on_applied) on_applied(seq);
         }
+        replaying_ = false;
+        resume_after_restart();
+        checkpoint();
+        LOG_INFO("room replayed", {{"room", room_id_}, {"commands", applied}, {"seq", journal_seq_}});
     }
-    void send_to_connection(websocketpp::connection_hdl hdl, const std::string& message) {
-        try {
-            ws_server_.send(hdl, message, websocketpp::frame::opcode::text);
-        } catch (const websocketpp::exception& e) {
-            Logger::error("WebSocket send error: " + std::string(e.what()));
-        }
+
+    // 当前对局状态，格式同日志中的快照
+    json snapshot() { return save_state(); }
+
+    // 把当前状态作为快照写入命令日志，之后的重放从这里开始
+    void checkpoint() {
+        commands_since_checkpoint_ = 0;
+        if (!journaling() || frozen_) return;
+        journal_->append({{"room", room_id_}, {"seq", journal_seq_}, {"catalog", CardCatalog::shared().version()},
+                          {"snapshot", save_state()}});
     }
 
-    void send_choose_card_info(std::string player_idnex_op){
-            // 发送移动接受消息
-            json accept_response;
-            accept_response["type"] = "special_action_request";
-            send_to_player(player_idnex_op, accept_response.dump());
+    // 房间被回收：记一条关闭记录，恢复时跳过本房间；之后本房间不再写日志
+    void close_journal() {
+        if (!journaling()) return;
+        journal_->append({{"room", room_id_}, {"seq", journal_seq_}, {"closed", true}});
+        journal_closed_ = true;
     }
 
-    void handle_player_join(websocketpp::connection_hdl hdl, const json& data) {
-        std::string player_id = data["player_id"];
-        
-        std::lock_guard<std::mutex> lock(game_mutex_);
-        
+    // 路由到本房间的连接计数，由GameServer在加入/断开时维护，用于判断房间何时可以回收
+    void acquire_connection() { online_.fetch_add(1, std::memory_order_relaxed); }
+    int release_connection() { return online_.fetch_sub(1, std::memory_order_acq_rel) - 1; }
+    int online() const { return online_.load(std::memory_order_acquire); }
+
+    // options.last_seq为重连客户端最后确认的下行消息序号，缺口仍在缓冲区内时只补发缺口，否则发送状态快照
+    void handle_player_join(websocketpp::connection_hdl hdl, const std::string& player_id,
+                            const JoinOptions& options = JoinOptions()) {
+        if (frozen_) return;
+        CommitScope commit(*this);
         // 检查是否是重新连接
         bool is_reconnect = (player_connections_.find(player_id) != player_connections_.end()) || 
                            (disconnected_players_.find(player_id) != disconnected_players_.end());
         
+        if (!is_reconnect && player_connections_.size() >= 2) {
+            // 游戏已满，发送错误消息
+            json error_response;
+            error_response["type"] = "game_full";
+            error_response["message"] = "Game is full, cannot join";
+            send_to_connection(hdl, error_response);
+            return;
+        }
+        // 房间号可以猜到，已占用的座位只能凭入座时发放的令牌接管；重放的加入在线上已验证过
+        if (is_reconnect && !replaying_) {
+            auto token = seat_tokens_.find(player_id);
+            if (token == seat_tokens_.end() || options.reconnect_token.empty() ||
+                token->second != options.reconnect_token) {
+                json error_response;
+                error_response["type"] = "seat_taken";
+                error_response["message"] = "Seat is taken, reconnect_token required";
+                send_to_connection(hdl, error_response);
+                LOG_WARN("reconnect rejected", {{"room", room_id_}, {"player", player_id}});
+                return;
+            }
+        }
+        if (!is_reconnect) {
+            seat_tokens_[player_id] = replaying_ ? options.reconnect_token : make_reconnect_token();
+        }
+        const std::string& token = seat_tokens_[player_id];
+        // 加入时的选项决定补发还是发快照、以及下行帧的格式，重放时需要原样还原，下行序号才能与线上一致
+        JournalScope journal(*this, [&player_id, &token, &options]() {
+            json record{{"op", "join"}, {"seat", player_id}, {"token", token},
+                        {"batch", options.batch}, {"delta", options.delta},
+                        {"compact_cards", options.compact_cards}, {"catalog_version", options.catalog_version}};
+            if (options.last_seq) record["last_seq"] = *options.last_seq;
+            return record;
+        });
+
+        json joined_response;
+        joined_response["type"] = "room_joined";
+        joined_response["room_id"] = room_id_;
+        joined_response["player_id"] = player_id;
+        joined_response["last_seq"] = outboxes_[player_id].last_seq();
+        joined_response["reconnect_token"] = token;
+        send_to_connection(hdl, joined_response);
+        seat_options_[player_id] = options;
+        // 紧凑格式的卡牌要靠目录还原，客户端缓存的版本过期或没有缓存时先下发目录
+        const CardCatalog& catalog = CardCatalog::shared();
+        if (options.compact_cards && options.catalog_version != catalog.version()) {
+            send_to_connection(hdl, catalog.toJson());
+        }
+        board_sync_[player_id].own.reset();
+        board_sync_[player_id].opponent.reset();
+
         if (is_reconnect) {
             // 重新连接处理
-            Logger::info("Player " + player_id + " reconnected");   
+            LOG_INFO("player reconnected", {{"room", room_id_}, {"player", player_id}});
             // 更新连接句柄
             player_connections_[player_id] = hdl; 
             // 从断开列表中移除
             disconnected_players_.erase(player_id);
-            // 立即发送当前游戏状态
-            send_cards_to_player(player_id);   
+            auto grace = grace_timers_.find(player_id);
+            if (grace != grace_timers_.end()) {
+                TimerService::cancel(grace->second.handle);
+                ++grace->second.generation;
+            }
+            // 补发断线期间错过的消息，缺口过大时发送当前游戏状态
+            resend_missed(player_id, options.last_seq);
             // 通知另一个玩家
             notify_player_reconnected(player_id);
             
-        } else if (player_connections_.size() < 2) {
+        } else {
             // 新玩家加入
             player_connections_[player_id] = hdl;
-            Logger::info("Player " + player_id + " joined the game");
+            LOG_INFO("player joined", {{"room", room_id_}, {"player", player_id}});
             
             // 如果两个玩家都加入了，开始游戏
             if (player_connections_.size() == 2) {
@@ -355,95 +711,724 @@ private:
                 }
                 broadcast_game_start();
             }
-            
-        } else {
-            // 游戏已满，发送错误消息
-            json error_response;
-            error_response["type"] = "game_full";
-            error_response["message"] = "Game is full, cannot join";
-            send_to_connection(hdl, error_response.dump());
         }
     }
 
-    std::vector<std::vector<Card*>> handle_player_action(websocketpp::connection_hdl hdl, const json& data) {
-        std::lock_guard<std::mutex> lock(game_mutex_);
+    void handle_player_disconnect(websocketpp::connection_hdl hdl, const std::string& disconnected_player) {
+        if (frozen_) return;
+        CommitScope commit(*this);
+        // 座位已被新连接接管（重连）时，旧连接的断开不影响玩家状态
+        if (!is_seat_connection(disconnected_player, hdl)) {
+            return;
+        }
+        JournalScope journal(*this, [&disconnected_player]() {
+            return json{{"op", "leave"}, {"seat", disconnected_player}};
+        });
+        // 标记玩家为断开状态，但不移除游戏数据
+        disconnected_players_.insert(disconnected_player);
+        LOG_INFO("player disconnected", {{"room", room_id_}, {"player", disconnected_player}});
+        if (match_active_ && timeouts_.reconnect_grace.count() > 0) {
+            SeatTimer& grace = grace_timers_[disconnected_player];
+            TimerService::cancel(grace.handle);
+            uint64_t generation = ++grace.generation;
+            grace.handle = schedule(timeouts_.reconnect_grace, [disconnected_player, generation](GameRoom& room) {
+                room.on_reconnect_grace_expired(disconnected_player, generation);
+            });
+        }
+        
+        // 通知另一个玩家
+        notify_player_disconnected(disconnected_player);
+    }
 
-        if(flag==1){
-            if(last_slots_cards[player_idnex].size()!=0){//如果去掉判断条件会导致没有四个空栏位，而是一个空指针
-                slots_cards=last_slots_cards[player_idnex];
-            }
-            player_bones=last_player_bones;
-        }else if(flag==2){//第二个玩家
-            if(cur_player_slots_cards[player_idnex].size()!=0){//如果去掉判断条件会导致没有四个空栏位
-                slots_cards=cur_player_slots_cards[player_idnex];
+    // 座位号由连接映射得到，不再信任payload中的player_id
+    void on_message(const std::string& seat, websocketpp::connection_hdl hdl, const InboundMessage& payload) {
+        // 已转存的房间不再处理任何消息，之后的改动不会进入新进程
+        if (frozen_) return;
+        // 被拒绝加入或已被顶替的连接不能操作该座位
+        if (!is_seat_connection(seat, hdl)) {
+            LOG_WARN("connection is not seated", {{"room", room_id_}, {"seat", seat}});
+            return;
+        }
+        const protocol::MessageType type = payload.type_id;
+        if (type == protocol::MessageType::board_ack) {
+            if (payload.seq) {
+                board_sync_[seat].own.ack(*payload.seq);
+                board_sync_[seat].opponent.ack(*payload.seq);
             }
-            player_bones=cur_player_bones;
+            return;
         }
+        JournalScope journal(*this, [&seat, &payload]() {
+            return json{{"op", "msg"}, {"seat", seat}, {"msg", payload.to_json()}};
+        });
+        // 本条消息引起的所有下行更新在处理结束后按接收方合并发送
+        CommitScope commit(*this);
         
-        //解析玩家出牌
-        // anly_slot_card_end=0;
-        slots_cards=game_play.an_slot_card(data, player_cards_, cardRandomizer, 
-            card_id, player_idnex, player_bones, slots_cards);
-        
-        if(choosing_card==0)//玩家结束
-        {   
-            send_choose_card_info(player_idnex_op);//发送对方玩家请求发牌的信息
-            int game_end = 0;
-            if (flag == 1) {
-                // 记录当前玩家的信息
-                last_slots_cards[player_idnex] = slots_cards;
-                last_player_bones=player_bones;
-            } else {
-                cur_player_bones=player_bones;
-                cur_player_slots_cards[player_idnex] = slots_cards;
+        player_idnex = seat;
 
-                //卡牌对战逻辑
-                int player_hp=game_play.cur_plays(cur_player_slots_cards,last_slots_cards, 
-                    player_idnex,player_idnex_op,player_cards_,game_end,last_player_bones,cur_player_bones, character_HP_flag);
+        if(player_idnex=="player1")  player_idnex_op="player2";
+        else player_idnex_op="player1";
+        //card_placement_update
+        
+        // if(choosing_card==1&&type=="special_action"&&flag>0)
+        if(choosing_card==1&&type==protocol::MessageType::special_action)
+        {
+            generate_unique_numbers(player_idnex, payload.draw);
+            if(flag==2) flag=0;
 
-                //发送游戏结束
-                if(game_end!=0){
-                    std::string winner;
-                    if(game_end==-1){//-5
-                        Logger::info(player_idnex_op+"loss the game over!!!!!!!!!!!!!!!");
-                        winner=player_idnex;
-                    }else if(game_end==1){//5
-                        Logger::info(player_idnex+"loss the game over!!!!!!!!!!!!!!!");
-                        winner=player_idnex_op;
-                    }
+            // 立即发送新卡牌
+            send_cards_to_player(player_idnex);
+            
+            choosing_card=0;
+        }else if(choosing_card==0){
+            if (type == protocol::MessageType::card_placement_update) {//收到场上卡牌更新消息
+                if(player_idnex!=last_player){
+                    //payload.action有"clear"和"add"两种，需要一个总的计数xianjiing，"clear"-1,"add"+1
+                    //同时当"add"的卡牌需要献祭时，需要确保总的计数最终为原计数-血滴数
+                    int xj_card_id=payload.card_id;
+                    if(payload.placement==protocol::PlacementAction::clear){
+                        for(auto &&it=player_cards_[player_idnex].begin();it!=player_cards_[player_idnex].end();it++){
+                            if((*it)->get_play_current_card_id()==xj_card_id){
+                                if((*it)->get_card_state()==1){
+                                    xianjiing+=1;
 
-                    json accept_response;
-                    accept_response["type"] = "player_hp";
-                    accept_response["message"]=player_hp;
-                    send_to_player(player_idnex, accept_response.dump());
-                    send_to_player(player_idnex_op, accept_response.dump());
-                    
-                    json accept_response;
-                    accept_response["type"] = "game_end";
-                    accept_response["message"]=std::string(winner)+" Win";
-                    send_to_player(player_idnex, accept_response.dump());
-                    send_to_player(player_idnex_op, accept_response.dump());
-                }else{
-                    //发送双方玩家血量信息
-                    json accept_response;
-                    accept_response["type"] = "player_hp";
-                    accept_response["message"]=player_hp;
-                    send_to_player(player_idnex, accept_response.dump());
-                    send_to_player(player_idnex_op, accept_response.dump());
+                                    if(flag==0){//第一个玩家回合结束前
+                                        last_player_bones+=1;
+                                        // slots_cards=last_slots_cards[player_idnex];
+                                        publish_sacrifice(player_idnex, last_slots_cards[player_idnex], **it, last_player_bones);
+                                    }else if(flag==1){//第二个玩家回合结束前
+                                        cur_player_bones+=1;
+                                        // slots_cards=cur_player_slots_cards[player_idnex];
+                                        publish_sacrifice(player_idnex, cur_player_slots_cards[player_idnex], **it, cur_player_bones);
+                                    }
 
-                    //当flag=1时，第一个玩家刚出完牌，此时player_idnex_op是第二个玩家，而last_slots_cards特指第一个玩家上次出的牌，
-                    //last_slots_cards[第一个玩家]才是有效的
-                    // std::string first_player_id;
-                    // first_player_id=player_idnex_op;     
-                    process_player_move(player_idnex_op,last_slots_cards[player_idnex_op]);//通知先手玩家自己栏位的信息
-                    // 通知先手玩家
-                    notify_opponent_move(player_idnex_op, last_slots_cards[player_idnex_op]);//通知后手玩家对方栏信息
-                }
-            }
+                                    (*it)->set_card_state(0);
+                                    // delete *it;
+                                    it=player_cards_[player_idnex].erase(it);
 
-            // 验证玩家是否已连接
-            if (player_connections_.find(player_idnex_op) == player_connections_.end()) {
-                Logger::error("Player " + player_idnex_op + " not connected");
+                                    //如果去掉会导致第一回合出场后的松鼠被献祭后回到手牌，但实际不存在了，需要通知玩家前端当前手牌去掉该松鼠
+                                    //当前出现在第一回合结束后，新打出一张牌并之后献祭原有的牌时会导致两张牌都丢失。
+                                    // if(round_flag==2&&adding==0){
+                                    if(adding==0){
+                                        if(flag==0){//第一个玩家回合结束前
+                                            // last_slots_cards[player_idnex].pop_back(it);
+                                            process_player_move(player_idnex, last_slots_cards[player_idnex]);
+                                        }else if(flag==1){//第二个玩家回合结束前
+                                        
+                                            process_player_move(player_idnex, cur_player_slots_cards[player_idnex]);
+                                        }
+                                    }
+                                    break;
+                                }else{
+                                    break;
+                                }
+                            }
+                        }
+                        
+                    } else if(payload.placement==protocol::PlacementAction::add){
+                        if(payload.card_cost.size()>0){
+                            // std::string cost = payload["card"]["cost"];
+                            if(payload.card_cost[0].resource_id==protocol::CostResource::blood){
+                                int cost_num=payload.card_cost[0].amount;
+                                if(xianjiing>=cost_num){
+                                    for(auto &&it=player_cards_[player_idnex].begin();it!=player_cards_[player_idnex].end();it++){
+                                        if((*it)->get_play_current_card_id()==xj_card_id){
+                                            (*it)->set_card_state(1);
+                                            xianjiing-=cost_num;
+                                            break;
+                                        }
+                                    }
+                                }
+                            }
+                        }else{
+                            for(auto &&it=player_cards_[player_idnex].begin();it!=player_cards_[player_idnex].end();it++){
+                                if((*it)->get_play_current_card_id()==xj_card_id){
+                                    (*it)->set_card_state(1);
+                                    adding=1;
+                                    if(flag==0){
+
+                                    }
+                                    break;
+                                }
+                            }
+                        }
+                        
+                    }
+                    //将当前玩家的骨头数量发给前端
+                    player_bonus={cur_player_bones, last_player_bones};
+
+                    json bonus_response;
+                    bonus_response["type"] = "player_bonus";
+                    bonus_response["message"]=player_bonus;
+                    bonus_response["blood"]=xianjiing;
+                    send_to_player(player_idnex, bonus_response);
+
+                    json bonus_response_op;
+                    bonus_response_op["type"] = "player_bonus";
+                    bonus_response_op["message"]=player_bonus;
+                    send_to_player(player_idnex_op, bonus_response_op);
+
+                }else{
+                    adding=0;
+                }
+            }
+            else if(type == protocol::MessageType::player_action) {
+                std::string player_id = player_idnex;
+                if (player_id == last_player) {
+                    LOG_DEBUG("received same player's action", {{"room", room_id_}, {"player", player_id}});
+                    // return;
+                } else {
+                    if(round_flag<2) round_flag++;
+                    
+                    flag+=1;
+                    //需要补充玩家出的牌是否满足条件，即注意花费
+                    ScopedTimer timer(metrics_.stage(GameMetrics::Stage::handle_player_action));
+                    TraceSpan span("handle_player_action");
+                    std::vector<std::vector<Card*>> slots_cards=handle_player_action(hdl, payload);   
+                    xianjiing=0;      
+                    if (!auto_passing_) afk_passes_[player_id] = 0;
+                    // 轮到对方，重新计时
+                    arm_turn_timer();
+                }
+                
+            } else if (type == protocol::MessageType::start_new_round) {
+                handle_start_new_round(hdl);
+            }
+        }
+    }
+
+private:
+    std::string opponent_of(const std::string& seat) const {
+        return seat == "player1" ? "player2" : "player1";
+    }
+
+    // 对局状态，与restore()一一对应；卡牌经CardTable按对象编号，同一张卡牌在手牌和栏位中只保存一次
+    json save_state() {
+        room_state::CardTable cards;
+        json state;
+        state["id"] = room_id_;
+        state["seed"] = seed_;
+        state["randomizer"] = cardRandomizer.saveState();
+        {
+            std::ostringstream rng;
+            rng << gen;
+            state["rng"] = rng.str();
+        }
+        state["play"] = game_play.saveState();
+
+        state["flag"] = flag;
+        state["choosing_card"] = choosing_card;
+        state["player_idnex"] = player_idnex;
+        state["player_idnex_op"] = player_idnex_op;
+        state["card_id"] = card_id;
+        state["fist"] = fist;
+        state["last_player"] = last_player;
+        state["last_player_bones"] = last_player_bones;
+        state["cur_player_bones"] = cur_player_bones;
+        state["player_bones"] = player_bones;
+        state["round_flag"] = round_flag;
+        state["anly_slot_card_end"] = anly_slot_card_end;
+        state["xianjiing"] = xianjiing;
+        state["adding"] = adding;
+        state["player_bonus"] = player_bonus;
+        state["player_hp"] = player_hp_;
+        state["character_HP_flag"] = character_HP_flag;
+
+        state["slots_cards"] = cards.ids(slots_cards);
+        state["last_slots_cards"] = json::object();
+        for (const auto& [seat, slots] : last_slots_cards) state["last_slots_cards"][seat] = cards.ids(slots);
+        state["cur_player_slots_cards"] = json::object();
+        for (const auto& [seat, slots] : cur_player_slots_cards) {
+            state["cur_player_slots_cards"][seat] = cards.ids(slots);
+        }
+        state["player_cards"] = json::object();
+        for (const auto& [seat, hand] : player_cards_) state["player_cards"][seat] = cards.ids(hand);
+        state["tokens"] = seat_tokens_;
+        state["new_round_requests"] = new_round_requests_;
+        state["afk_passes"] = afk_passes_;
+        state["turn_seat"] = turn_seat_;
+        // 座位 -> 已发出的最后一条下行消息序号
+        state["seats"] = json::object();
+        for (const auto& [seat, hdl] : player_connections_) state["seats"][seat] = outboxes_[seat].last_seq();
+        state["match_active"] = match_active_;
+        state["journal_seq"] = journal_seq_;
+        state["cards"] = cards.states();
+        return state;
+    }
+
+    // save_state()的逆过程；座位都记为断线，重发缓冲区从转存时的序号继续
+    void load_state(const json& state) {
+        room_state::CardTable cards;
+        seed_ = state.value("seed", seed_);
+        cardRandomizer.restoreState(state.at("randomizer"));
+        cards.rebuild(state.at("cards"), cardRandomizer);
+        {
+            std::istringstream rng(state.at("rng").get<std::string>());
+            rng >> gen;
+        }
+        game_play.restoreState(state.at("play"));
+
+        flag = state.at("flag").get<int>();
+        choosing_card = state.at("choosing_card").get<int>();
+        player_idnex = state.at("player_idnex").get<std::string>();
+        player_idnex_op = state.at("player_idnex_op").get<std::string>();
+        card_id = state.at("card_id").get<int>();
+        fist = state.at("fist").get<int>();
+        last_player = state.at("last_player").get<std::string>();
+        last_player_bones = state.at("last_player_bones").get<int>();
+        cur_player_bones = state.at("cur_player_bones").get<int>();
+        player_bones = state.at("player_bones").get<int>();
+        round_flag = state.at("round_flag").get<int>();
+        anly_slot_card_end = state.at("anly_slot_card_end").get<int>();
+        xianjiing = state.at("xianjiing").get<int>();
+        adding = state.at("adding").get<int>();
+        player_bonus = state.at("player_bonus").get<std::vector<int>>();
+        player_hp_ = state.at("player_hp").get<int>();
+        character_HP_flag = state.at("character_HP_flag").get<int>();
+
+        slots_cards = cards.slots(state.at("slots_cards"));
+        for (const auto& [seat, ids] : state.at("last_slots_cards").items()) {
+            last_slots_cards[seat] = cards.slots(ids);
+        }
+        for (const auto& [seat, ids] : state.at("cur_player_slots_cards").items()) {
+            cur_player_slots_cards[seat] = cards.slots(ids);
+        }
+        for (const auto& [seat, ids] : state.at("player_cards").items()) {
+            player_cards_[seat] = cards.cards(ids);
+        }
+        if (state.contains("tokens")) {
+            for (const auto& [seat, token] : state.at("tokens").items()) {
+                seat_tokens_[seat] = token.get<std::string>();
+            }
+        }
+        for (const auto& seat : state.at("new_round_requests")) {
+            new_round_requests_.insert(seat.get<std::string>());
+        }
+        for (const auto& [seat, passes] : state.at("afk_passes").items()) {
+            afk_passes_[seat] = passes.get<int>();
+        }
+        turn_seat_ = state.value("turn_seat", std::string());
+        for (const auto& [seat, last_seq] : state.at("seats").items()) {
+            player_connections_[seat] = websocketpp::connection_hdl();
+            disconnected_players_.insert(seat);
+            outboxes_[seat].resume_after(last_seq.get<uint64_t>());
+        }
+
+        match_active_ = state.at("match_active").get<bool>();
+        journal_seq_ = state.value("journal_seq", uint64_t(0));
+    }
+
+    // 恢复后等待玩家重连：对局进行中时为两个座位安排重连宽限并重新开始回合计时
+    void resume_after_restart() {
+        for (auto& [seat, hdl] : player_connections_) {
+            hdl = websocketpp::connection_hdl();
+            disconnected_players_.insert(seat);
+        }
+        if (match_active_) {
+            for (const auto& [seat, hdl] : player_connections_) {
+                if (timeouts_.reconnect_grace.count() == 0) break;
+                SeatTimer& grace = grace_timers_[seat];
+                uint64_t generation = ++grace.generation;
+                std::string owner = seat;
+                grace.handle = schedule(timeouts_.reconnect_grace, [owner, generation](GameRoom& room) {
+                    room.on_reconnect_grace_expired(owner, generation);
+                });
+            }
+            arm_turn_timer();
+        }
+        LOG_INFO("room restored", {{"room", room_id_}, {"seats", player_connections_.size()},
+                                   {"match_active", match_active_}});
+    }
+
+    // 重新执行一条日志命令，与记录处的入口一一对应；记录时已通过的检查在重放状态下同样成立
+    void apply(const json& command) {
+        const std::string op = command.at("op").get<std::string>();
+        const std::string seat = command.value("seat", std::string());
+        auto seat_hdl = [this, &seat]() {
+            auto it = player_connections_.find(seat);
+            return it != player_connections_.end() ? it->second : websocketpp::connection_hdl();
+        };
+        if (op == "msg") {
+            InboundMessage message;
+            std::string error;
+            if (!InboundMessage::parse(WireCodec::json, command.at("msg").dump(), message, error)) {
+                throw std::runtime_error("bad journaled message: " + error);
+            }
+            on_message(seat, seat_hdl(), message);
+        } else if (op == "join") {
+            JoinOptions options;
+            options.reconnect_token = command.value("token", std::string());
+            if (command.contains("last_seq")) options.last_seq = command.at("last_seq").get<uint64_t>();
+            options.batch = command.value("batch", false);
+            options.delta = command.value("delta", false);
+            options.compact_cards = command.value("compact_cards", false);
+            options.catalog_version = command.value("catalog_version", std::string());
+            handle_player_join(websocketpp::connection_hdl(), seat, options);
+        } else if (op == "leave") {
+            handle_player_disconnect(seat_hdl(), seat);
+        } else if (op == "turn_timeout") {
+            on_turn_expired(turn_generation_);
+        } else if (op == "forfeit") {
+            CommitScope commit(*this);
+            forfeit(seat, "disconnect");
+        } else if (op == "new_round_timeout") {
+            on_new_round_expired(new_round_generation_);
+        } else {
+            throw std::runtime_error("unknown journal op " + op);
+        }
+    }
+
+    // 一条日志命令的执行范围，可嵌套：只有最外层记入日志（自动跳过时代发的消息不重复记录），最外层结束时按需写快照
+    // command只在需要记录时才调用
+    struct JournalScope {
+        GameRoom& room;
+        template <typename Command>
+        JournalScope(GameRoom& r, Command&& command) : room(r) {
+            if (room.journal_depth_++ == 0 && room.journaling()) {
+                room.journal_->append({{"room", room.room_id_}, {"seq", ++room.journal_seq_}, {"cmd", command()}});
+                ++room.commands_since_checkpoint_;
+            }
+        }
+        ~JournalScope() {
+            if (--room.journal_depth_ == 0 && room.journaling() && std::uncaught_exceptions() == 0 &&
+                room.commands_since_checkpoint_ >= room.journal_->options().snapshot_every) {
+                room.checkpoint();
+            }
+        }
+    };
+
+    bool journaling() const { return journal_ && !replaying_ && !journal_closed_; }
+
+    // 重放期间不发布事件
+    template <typename Event>
+    bool wants_event() const {
+        return !replaying_ && events_.wants<Event>();
+    }
+
+    // 献祭与战斗死亡一样发布死亡和骨头事件；slots为献祭方当前回合的栏位，找不到卡牌时slot记为-1
+    void publish_sacrifice(const std::string& owner, const std::vector<std::vector<Card*>>& slots,
+                           const Card& card, int bones) {
+        if (wants_event<DeathEvent>()) {
+            int slot = -1;
+            for (size_t i = 0; i < slots.size() && slot < 0; ++i) {
+                if (std::find(slots[i].begin(), slots[i].end(), &card) != slots[i].end()) slot = static_cast<int>(i);
+            }
+            events_.publish(DeathEvent{room_id_, owner, card.getName(), card.get_play_current_card_id(), slot});
+        }
+        if (wants_event<BoneGainEvent>()) {
+            events_.publish(BoneGainEvent{room_id_, owner, 1, bones});
+        }
+    }
+
+    // 定时器在定时器线程上到期，回调投递回房间strand执行；房间已回收时直接丢弃
+    template <typename Handler>
+    TimerService::Handle schedule(std::chrono::milliseconds delay, Handler handler) {
+        if (replaying_) return nullptr;
+        std::weak_ptr<GameRoom> weak = weak_from_this();
+        return timers_.schedule(delay, [weak, handler]() {
+            if (auto room = weak.lock()) {
+                room->post([room, handler]() {
+                    if (!room->frozen_) handler(*room);
+                });
+            }
+        });
+    }
+
+    // 轮到last_player的对手出牌，为其重新计时
+    void arm_turn_timer() {
+        TimerService::cancel(turn_timer_);
+        uint64_t generation = ++turn_generation_;
+        if (!match_active_) return;
+        // 关闭回合计时时也记下座位：重放的turn_timeout不经过计时器，只看这里
+        turn_seat_ = opponent_of(last_player);
+        if (timeouts_.turn.count() == 0) return;
+        turn_timer_ = schedule(timeouts_.turn, [generation](GameRoom& room) {
+            room.on_turn_expired(generation);
+        });
+    }
+
+    void end_match() {
+        match_active_ = false;
+        TimerService::cancel(turn_timer_);
+        ++turn_generation_;
+    }
+
+    void on_turn_expired(uint64_t generation) {
+        if (generation != turn_generation_ || !match_active_) return;
+        JournalScope journal(*this, []() { return json{{"op", "turn_timeout"}}; });
+        CommitScope commit(*this);
+        std::string seat = turn_seat_;
+        int passes = ++afk_passes_[seat];
+        if (timeouts_.afk_forfeit_passes > 0 && passes >= timeouts_.afk_forfeit_passes) {
+            forfeit(seat, "afk");
+            return;
+        }
+        auto_pass(seat);
+        // 自动出牌没有推进回合时（状态不允许出牌）继续为同一座位计时，避免对局停住
+        if (generation == turn_generation_) arm_turn_timer();
+    }
+
+    // 代替超时的玩家完成本回合：需要先抽牌时抽一张松鼠，然后不改动场上卡牌直接结束回合
+    void auto_pass(const std::string& seat) {
+        auto it = player_connections_.find(seat);
+        if (it == player_connections_.end()) return;
+        websocketpp::connection_hdl hdl = it->second;
+        LOG_INFO("turn auto-passed", {{"room", room_id_}, {"player", seat}, {"passes", afk_passes_[seat]}});
+
+        json notice;
+        notice["type"] = "turn_auto_pass";
+        notice["player_id"] = seat;
+        broadcast(notice);
+
+        auto_passing_ = true;
+        if (choosing_card == 1) {
+            InboundMessage draw;
+            draw.type = "special_action";
+            draw.type_id = protocol::MessageType::special_action;
+            draw.action_type = "squirrels";
+            draw.draw = protocol::DrawKind::squirrels;
+            on_message(seat, hdl, draw);
+        }
+        InboundMessage pass;
+        pass.type = "player_action";
+        pass.type_id = protocol::MessageType::player_action;
+        on_message(seat, hdl, pass);
+        auto_passing_ = false;
+    }
+
+    void on_reconnect_grace_expired(const std::string& seat, uint64_t generation) {
+        auto it = grace_timers_.find(seat);
+        if (it == grace_timers_.end() || it->second.generation != generation) return;
+        if (!match_active_ || disconnected_players_.count(seat) == 0) return;
+        JournalScope journal(*this, [&seat]() { return json{{"op", "forfeit"}, {"seat", seat}}; });
+        CommitScope commit(*this);
+        forfeit(seat, "disconnect");
+    }
+
+    void on_new_round_expired(uint64_t generation) {
+        if (generation != new_round_generation_ || new_round_requests_.size() != 1) return;
+        JournalScope journal(*this, []() { return json{{"op", "new_round_timeout"}}; });
+        CommitScope commit(*this);
+        std::string requester = *new_round_requests_.begin();
+        new_round_requests_.clear();
+        LOG_INFO("new round request timed out", {{"room", room_id_}, {"player", requester}});
+        json response;
+        response["type"] = "new_round_timeout";
+        response["message"] = "Other player did not confirm the new round";
+        send_to_player(requester, response);
+    }
+
+    // 判负：loser超时或断线未归，对手获胜，与正常结束时发送相同的game_end
+    void forfeit(const std::string& loser, const char* reason) {
+        std::string winner = opponent_of(loser);
+        end_match();
+        LOG_INFO("game forfeited", {{"room", room_id_}, {"loser", loser}, {"reason", reason}});
+        if (wants_event<GameEndEvent>()) {
+            events_.publish(GameEndEvent{room_id_, winner, loser, player_hp_});
+        }
+        json end_response;
+        end_response["type"] = "game_end";
+        end_response["message"] = winner + " Win";
+        end_response["reason"] = reason;
+        broadcast(end_response);
+    }
+
+    // 座位当前的场上栏位：先手方记录在last_slots_cards，后手方记录在cur_player_slots_cards
+    std::vector<std::vector<Card*>> board_of(const std::string& seat) {
+        auto cur_it = cur_player_slots_cards.find(seat);
+        if (cur_it != cur_player_slots_cards.end() && !cur_it->second.empty()) return cur_it->second;
+        auto last_it = last_slots_cards.find(seat);
+        if (last_it != last_slots_cards.end() && !last_it->second.empty()) return last_it->second;
+        return std::vector<std::vector<Card*>>(4);
+    }
+
+    void resend_missed(const std::string& player_id, std::optional<uint64_t> last_seq) {
+        std::vector<std::shared_ptr<const OutboundMessage>> missed;
+        auto& outbox = outboxes_[player_id];
+        if (last_seq && outbox.collect_after(*last_seq, missed)) {
+            for (auto& message : missed) {
+                deliver(player_id, message);
+            }
+            LOG_INFO("replayed missed messages", {{"room", room_id_}, {"player", player_id}, {"count", missed.size()}});
+            return;
+        }
+        send_snapshot(player_id);
+    }
+
+    // 状态快照：用客户端已支持的消息类型重建手牌、双方栏位、血量和骨头数
+    void send_snapshot(const std::string& player_id) {
+        std::string opponent_id = opponent_of(player_id);
+        process_player_move(player_id, board_of(player_id));
+        if (player_connections_.count(opponent_id)) {
+            notify_opponent_move(opponent_id, board_of(opponent_id));
+        }
+
+        json hp_response;
+        hp_response["type"] = "player_hp";
+        hp_response["message"] = player_hp_;
+        send_to_player(player_id, hp_response);
+
+        player_bonus={cur_player_bones, last_player_bones};
+        json bonus_response;
+        bonus_response["type"] = "player_bonus";
+        bonus_response["message"]=player_bonus;
+        send_to_player(player_id, bonus_response);
+        LOG_INFO("sent state snapshot", {{"room", room_id_}, {"player", player_id}});
+    }
+
+    // 按首次出现的顺序追加卡牌名，重复的卡牌记为 名字(xN)；卡牌数很少，线性查找比哈希表便宜
+    static void append_card_counts(std::string& out, const std::vector<Card*>& cards) {
+        std::vector<std::pair<Card*, int>> counts;
+        counts.reserve(cards.size());
+        for (auto card : cards) {
+            auto it = std::find_if(counts.begin(), counts.end(),
+                                   [card](const auto& entry) { return entry.first == card; });
+            if (it != counts.end()) it->second++;
+            else counts.emplace_back(card, 1);
+        }
+        for (size_t i = 0; i < counts.size(); ++i) {
+            if (i > 0) out += ", ";
+            out += counts[i].first->getName();
+            if (counts[i].second > 1) out += "(x" + std::to_string(counts[i].second) + ")";
+        }
+    }
+
+    // 128位随机令牌，不取自对局种子，不影响对局的随机序列
+    static std::string make_reconnect_token() {
+        static const char kHex[] = "0123456789abcdef";
+        std::random_device rd;
+        std::string token;
+        for (int i = 0; i < 4; ++i) {
+            uint32_t bits = rd();
+            for (int j = 0; j < 8; ++j, bits >>= 4) token.push_back(kHex[bits & 0xf]);
+        }
+        return token;
+    }
+
+    bool is_seat_connection(const std::string& seat, websocketpp::connection_hdl hdl) const {
+        auto it = player_connections_.find(seat);
+        if (it == player_connections_.end()) return false;
+        std::owner_less<websocketpp::connection_hdl> less;
+        return !less(it->second, hdl) && !less(hdl, it->second);
+    }
+
+    void send_to_connection(websocketpp::connection_hdl hdl, const json& message) {
+        FrameSender::send(ws_server_, hdl, message);
+    }
+
+    void send_choose_card_info(std::string player_idnex_op){
+            // 发送移动接受消息
+            json accept_response;
+            accept_response["type"] = "special_action_request";
+            send_to_player(player_idnex_op, accept_response);
+    }
+
+    // 本回合出牌解析完成后发布MoveEvent，没有订阅方时不构建事件
+    void publish_move() {
+        if (!wants_event<MoveEvent>()) return;
+        MoveEvent move;
+        move.room = room_id_;
+        move.player = player_idnex;
+        for (const auto& slot : slots_cards) {
+            move.played.push_back(!slot.empty() && slot[0] ? slot[0]->getName() : std::string());
+        }
+        move.hand_size = player_cards_[player_idnex].size();
+        move.bones = player_bones;
+        events_.publish(std::move(move));
+    }
+
+    std::vector<std::vector<Card*>> handle_player_action(websocketpp::connection_hdl hdl, const InboundMessage& data) {
+        if(flag==1){
+            if(last_slots_cards[player_idnex].size()!=0){//如果去掉判断条件会导致没有四个空栏位，而是一个空指针
+                slots_cards=last_slots_cards[player_idnex];
+            }
+            player_bones=last_player_bones;
+        }else if(flag==2){//第二个玩家
+            if(cur_player_slots_cards[player_idnex].size()!=0){//如果去掉判断条件会导致没有四个空栏位
+                slots_cards=cur_player_slots_cards[player_idnex];
+            }
+            player_bones=cur_player_bones;
+        }
+        
+        //解析玩家出牌
+        // anly_slot_card_end=0;
+        {
+            ScopedTimer timer(metrics_.stage(GameMetrics::Stage::an_slot_card));
+            TraceSpan span("an_slot_card");
+            slots_cards=game_play.an_slot_card(data.slots, player_cards_, cardRandomizer, 
+                card_id, player_idnex, player_bones, slots_cards);
+        }
+        publish_move();
+        
+        if(choosing_card==0)//玩家结束
+        {   
+            send_choose_card_info(player_idnex_op);//发送对方玩家请求发牌的信息
+            int game_end = 0;
+            if (flag == 1) {
+                // 记录当前玩家的信息
+                last_slots_cards[player_idnex] = slots_cards;
+                last_player_bones=player_bones;
+            } else {
+                cur_player_bones=player_bones;
+                cur_player_slots_cards[player_idnex] = slots_cards;
+
+                //卡牌对战逻辑
+                int player_hp;
+                {
+                    ScopedTimer timer(metrics_.stage(GameMetrics::Stage::cur_plays));
+                    TraceSpan span("cur_plays");
+                    player_hp=game_play.cur_plays(cur_player_slots_cards,last_slots_cards, 
+                        player_idnex,player_idnex_op,player_cards_,game_end,last_player_bones,cur_player_bones, character_HP_flag);
+                }
+                player_hp_ = player_hp;
+
+                //发送游戏结束
+                if(game_end!=0){
+                    std::string winner;
+                    if(game_end==-1){//-5
+                        LOG_INFO("game over", {{"room", room_id_}, {"loser", player_idnex_op}});
+                        winner=player_idnex;
+                    }else if(game_end==1){//5
+                        LOG_INFO("game over", {{"room", room_id_}, {"loser", player_idnex}});
+                        winner=player_idnex_op;
+                    }
+
+                    json accept_response;
+                    accept_response["type"] = "player_hp";
+                    accept_response["message"]=player_hp;
+                    send_to_player(player_idnex, accept_response);
+                    send_to_player(player_idnex_op, accept_response);
+                    
+                    end_match();
+                    if (wants_event<GameEndEvent>()) {
+                        events_.publish(GameEndEvent{room_id_, winner, opponent_of(winner), player_hp});
+                    }
+
+                    json end_response;
+                    end_response["type"] = "game_end";
+                    end_response["message"]=std::string(winner)+" Win";
+                    send_to_player(player_idnex, end_response);
+                    send_to_player(player_idnex_op, end_response);
+                }else{
+                    //发送双方玩家血量信息
+                    json accept_response;
+                    accept_response["type"] = "player_hp";
+                    accept_response["message"]=player_hp;
+                    send_to_player(player_idnex, accept_response);
+                    send_to_player(player_idnex_op, accept_response);
+
+                    //当flag=1时，第一个玩家刚出完牌，此时player_idnex_op是第二个玩家，而last_slots_cards特指第一个玩家上次出的牌，
+                    //last_slots_cards[第一个玩家]才是有效的
+                    // std::string first_player_id;
+                    // first_player_id=player_idnex_op;     
+                    process_player_move(player_idnex_op,last_slots_cards[player_idnex_op]);//通知先手玩家自己栏位的信息
+                    // 通知先手玩家
+                    notify_opponent_move(player_idnex_op, last_slots_cards[player_idnex_op]);//通知后手玩家对方栏信息
+                }
+            }
+
+            // 验证玩家是否已连接
+            if (player_connections_.find(player_idnex_op) == player_connections_.end()) {
+                LOG_ERROR("player not connected", {{"room", room_id_}, {"player", player_idnex_op}});
                 return slots_cards;
             }
 
@@ -452,18 +1437,18 @@ private:
             json bonus_response;
             bonus_response["type"] = "player_bonus";
             bonus_response["message"]=player_bonus;
-            send_to_player(player_idnex, bonus_response.dump());
+            send_to_player(player_idnex, bonus_response);
 
             json bonus_response_op;
             bonus_response_op["type"] = "player_bonus";
             bonus_response_op["message"]=player_bonus;
-            send_to_player(player_idnex_op, bonus_response_op.dump());
+            send_to_player(player_idnex_op, bonus_response_op);
             choosing_card=1;
         }  
         
         // 验证玩家是否已连接
         if (player_connections_.find(player_idnex) == player_connections_.end()) {
-            Logger::error("Player " + player_idnex + " not connected");
+            LOG_ERROR("player not connected", {{"room", room_id_}, {"player", player_idnex}});
             return slots_cards;
         }
 
@@ -492,51 +1477,25 @@ private:
         
         if (!opponent_id.empty()) {
             json opponent_response;
+            wire::RawFields raw;
             opponent_response["type"] = "opponent_move";
             
-            // 将卡牌指针向量转换为名称数组
-            json card_names = json::array();
-            for (auto &cards : slots_cards) {
-                json slot_json = json::array();
-                for(auto &&card=cards.begin();card!=cards.end();card++){
-                // for(auto &card : cards){
-
-                    // if(card&&card->get_card_state()!=0&&card->getHP()>0){
-                    if((*card)->get_card_state()!=0&&(*card)->getHP()>0){
-                        // slot_json.push_back(card->toJson());  // 使用 toJson() 方法
-                        slot_json.push_back((*card)->toJson());
-                    }
-                    else{
-                         slot_json.push_back(nullptr);
-                    }
-                }
-                card_names.push_back(slot_json);
-            }
-
-            opponent_response["cards_played"] = card_names;  // 现在可以赋值了
-
-            json slots_json = json::array();
-            for (const auto& slot : slots_cards) {
-                json slot_json = json::array();
-                for(auto &&card=slot.begin();card!=slot.end();card++){
-                // for (Card* card : slot) {
-                    // if (card&&card->get_card_state()!=0&&card->getHP()>0) {
-                     if((*card)->get_card_state()!=0&&(*card)->getHP()>0){
-                        slot_json.push_back((*card)->toJson());  // 使用 toJson() 方法
-                    }
-                    else{
-                        slot_json.push_back(nullptr);
-                    }
-                }
-                slots_json.push_back(slot_json);
+            if (seat_options_[opponent_id].delta) {
+                opponent_response["board"] = board_sync_[opponent_id].opponent.encode(
+                    capture_board(slots_cards), outboxes_[opponent_id].next_seq(),
+                    seat_options_[opponent_id].compact_cards);
+            } else {
+                // cards_played和slots内容相同，只构建一次
+                std::string card_names = board_fragment(opponent_id, slots_cards, false);
+                raw.emplace_back("cards_played", card_names);
+                raw.emplace_back("slots", std::move(card_names));
             }
-            opponent_response["slots"] = slots_json;  // 现在可以赋值了
       
             // opponent_response["numbers_played"] = numbers;
             opponent_response["player_id"] = player_id;
             
-            send_to_player(opponent_id, opponent_response.dump());
-            Logger::info("Notified " + opponent_id + " about " + player_id + "'s move");
+            send_to_player(opponent_id, opponent_response, raw);
+            LOG_DEBUG("notified opponent move", {{"room", room_id_}, {"to", opponent_id}, {"player", player_id}});
         }
     }
 
@@ -556,8 +1515,8 @@ private:
             disconnect_response["message"] = player_id + " has disconnected";
             disconnect_response["player_id"] = player_id;
             
-            send_to_player(opponent_id, disconnect_response.dump());
-            Logger::info("Notified " + opponent_id + " about " + player_id + " disconnection");
+            send_to_player(opponent_id, disconnect_response);
+            LOG_INFO("notified opponent disconnection", {{"room", room_id_}, {"to", opponent_id}, {"player", player_id}});
         }
     }
     
@@ -577,24 +1536,23 @@ private:
             reconnect_response["message"] = player_id + " has reconnected";
             reconnect_response["player_id"] = player_id;
             
-            send_to_player(opponent_id, reconnect_response.dump());
-            Logger::info("Notified " + opponent_id + " about " + player_id + " reconnection");
+            send_to_player(opponent_id, reconnect_response);
+            LOG_INFO("notified opponent reconnection", {{"room", room_id_}, {"to", opponent_id}, {"player", player_id}});
         }
     }
 
-    void handle_start_new_round(websocketpp::connection_hdl hdl, const json& data) {
-        std::string player_id = data["player_id"];
+    void handle_start_new_round(websocketpp::connection_hdl hdl) {
+        std::string player_id = player_idnex;
         
-        std::lock_guard<std::mutex> lock(game_mutex_);
+        // 检查是否两个玩家都请求了新回合（按房间记录）
+        new_round_requests_.insert(player_id);
         
-        // 检查是否两个玩家都请求了新回合
-        static std::set<std::string> new_round_requests;
-        new_round_requests.insert(player_id);
-        
-        if (new_round_requests.size() == 2) {
+        if (new_round_requests_.size() == 2) {
             // 两个玩家都请求了，开始新回合
             flag = 0;
-            new_round_requests.clear();
+            new_round_requests_.clear();
+            TimerService::cancel(new_round_timer_);
+            ++new_round_generation_;
             
             // 重置游戏状态
             reset_game();
@@ -602,28 +1560,34 @@ private:
             // 重新生成数字并分配给玩家
             generate_unique_numbers();
             
-            Logger::info("New round started by both players");
             // 发送新数字给所有玩家
             for (auto& [pid, player_hdl] : player_connections_) {
-                Logger::info("New round started by both players "+player_id);
                 send_cards_to_player(pid);
             }
             
             broadcast_game_start();
-            Logger::info("New round started by both players");
+            LOG_INFO("new round started by both players", {{"room", room_id_}});
         } else {
             // 只有一个玩家请求，等待另一个
-            Logger::info("Player " + player_id + " requested new round, waiting for other player");
+            LOG_INFO("new round requested, waiting for other player", {{"room", room_id_}, {"player", player_id}});
             
             // 通知玩家等待另一个玩家
             json wait_response;
             wait_response["type"] = "waiting_for_opponent";
             wait_response["message"] = "Waiting for other player to confirm new round";
-            send_to_player(player_id, wait_response.dump());
+            send_to_player(player_id, wait_response);
+
+            if (timeouts_.new_round.count() > 0) {
+                TimerService::cancel(new_round_timer_);
+                uint64_t generation = ++new_round_generation_;
+                new_round_timer_ = schedule(timeouts_.new_round, [generation](GameRoom& room) {
+                    room.on_new_round_expired(generation);
+                });
+            }
         }
     }
     
-    void generate_unique_numbers(std::string player_id="", std::string action_type="") {
+    void generate_unique_numbers(std::string player_id="", protocol::DrawKind draw=protocol::DrawKind::unknown) {
         
         // std::random_device rd;
         // std::mt19937 gen(rd());
@@ -641,26 +1605,25 @@ private:
             // player_cards_["player1"].push_back(cardRandomizer.getskip("鸽子"));
             // player_cards_["player2"].push_back(cardRandomizer.getskip("鸽子"));
 
-            // 生成6个随机数字并平均分配
-            std::unordered_multiset<Card*> all_numbers;
+            // 生成6个随机数字并平均分配；按抽取顺序交替分发，分配结果只取决于对局种子
+            std::vector<Card*> all_numbers;
+            all_numbers.reserve(6);
             while (all_numbers.size() < 6) {
-                all_numbers.insert(cardRandomizer.getRandomCard());
+                all_numbers.push_back(cardRandomizer.getRandomCard());
             }
             
-            auto it = all_numbers.begin();
             for (int i = 0; i < 6; ++i) {
                 if (i % 2 == 0) 
-                    player_cards_["player1"].push_back(*it);
+                    player_cards_["player1"].push_back(all_numbers[i]);
                 else 
-                    player_cards_["player2"].push_back(*it);
-                ++it;
+                    player_cards_["player2"].push_back(all_numbers[i]);
             }
         } else {
-            if(action_type=="creations")
+            if(draw==protocol::DrawKind::creations)
             {
                 player_cards_[player_id].push_back(cardRandomizer.getRandomCard());
             }
-            else //if(action_type=="squirrels")
+            else //if(draw==protocol::DrawKind::squirrels)
             {
                 player_cards_[player_id].push_back(cardRandomizer.getsquirrel());
             }
@@ -670,132 +1633,136 @@ private:
             // player_numbers_["player2"].insert(dis(gen));
         }
         
-        Logger::info("Generated numbers for both players");
+        LOG_DEBUG("generated cards", {{"room", room_id_}, {"player", player_id}});
     }
     
     void send_cards_to_player(const std::string& player_id) {
         json response;
         response["type"] = "numbers_assigned";
+        wire::RawFields raw;
         if(player_cards_.find(player_id)!=player_cards_.end()){
-            json card_info = json::array();
+            const JoinOptions& options = seat_options_[player_id];
+            std::vector<const Card*> hand;
             for(auto &card:player_cards_[player_id]){
                 if(card&&card->get_card_state()==0){//如果card&&card->get_card_state()==0，已经在场上但还存活的手牌因为状态为1,没有被发送给客户端，导致直接丢失
                 // if(card){
-                    card_json = card->toJson();  // 获取基础JSON
-                    // // 添加地址信息
-                    // card_json["memory_address"] = reinterpret_cast<uintptr_t>(card);
-                    // card_json["is_valid"] = (card != nullptr);
-                    card_info.push_back(card_json);
+                    hand.push_back(card);
                 }
             }
-            response["cards"] = card_info;
-            
-                // card_json["is_valid"] = (card != nullptr);
+            // 直接拼接各卡牌缓存的编码片段
+            std::string card_info;
+            wire::begin_array(options.codec, card_info, hand.size());
+            for (size_t i = 0; i < hand.size(); ++i) {
+                wire::array_separator(options.codec, card_info, i);
+                card_info += hand[i]->fragment(options.codec, options.compact_cards);
+            }
+            wire::end_array(options.codec, card_info);
+            raw.emplace_back("cards", std::move(card_info));
         }
         // response["numbers"] = player_numbers_[player_id];
         
         //  Logger::info("send_to_player h players");
-        send_to_player(player_id, response.dump());
+        send_to_player(player_id, response, raw);
     }
     
     void process_player_move(const std::string& player_id, const std::vector<std::vector<Card*>>& slots_cards) {
         //专门用来更新己方场上的卡牌信息
          
-        // 记录玩家操作
+        // 出牌描述会作为move_accepted的message发给客户端；剩余手牌的描述只用于日志，调试级别关闭时不构建
         std::string move_desc = player_id + " played: ";
-        std::unordered_map<Card*, int> played_count;
-        for (auto cards : slots_cards) {
-            for(auto card : cards)
-            {
-                if(card)
-                {
-                    played_count[card]++;
-                }
-                
-            }
-        }
-        
-        bool first = true;
-        for (const auto& [card, count] : played_count) {
-            if (!first) move_desc += ", ";
-            move_desc += card->getName();
-            if (count > 1) {
-                move_desc += "(x" + std::to_string(count) + ")";
-            }
-            first = false;
-        }
-        
-        // 记录剩余数字
-        std::string move_desc1 = player_id + " have: ";
-        std::unordered_map<Card *, int> remaining_count;
-        for (auto &card : player_cards_[player_id]) {
-            remaining_count[card]++;
-        }
-        
-        first = true;
-        for (const auto& [card, count] : remaining_count) {
-            if (!first) move_desc1 += ", ";
-            move_desc1 += card->getName();
-            if (count > 1) {
-                move_desc1 += "(x" + std::to_string(count) + ")";
+        std::vector<Card*> played;
+        for (const auto& cards : slots_cards) {
+            for (auto card : cards) {
+                if (card) played.push_back(card);
             }
-            first = false;
         }
+        append_card_counts(move_desc, played);
 
         // 发送数字更新
         send_cards_to_player(player_id);
-        
-        Logger::info(move_desc + move_desc1);
+
+        if (Logger::enabled(LogLevel::debug)) {
+            std::string move_desc1 = player_id + " have: ";
+            append_card_counts(move_desc1, player_cards_[player_id]);
+            LOG_DEBUG("move", {{"room", room_id_}, {"player", player_id}, {"played", move_desc}, {"hand", move_desc1}});
+        }
         
         // 发送移动接受消息
         json accept_response;
+        wire::RawFields raw;
         accept_response["type"] = "move_accepted";
         accept_response["message"] = move_desc;
         
-        json card_info = json::array();
-        
-    
+        if (seat_options_[player_id].delta) {
+            accept_response["board"] = board_sync_[player_id].own.encode(
+                capture_board(slots_cards), outboxes_[player_id].next_seq(),
+                seat_options_[player_id].compact_cards);
+        } else {
+            raw.emplace_back("cards_played", board_fragment(player_id, slots_cards, true));
+        }
 
-        //上述注释掉的代码若某槽位无卡牌会被自动略过，导致只有有卡牌的信息会被加进card_info，没法关联槽位
-        // for (auto &cards : slots_cards) {
-        for (auto &&cards=slots_cards.begin(); cards != slots_cards.end(); ++cards) {
-            // 如果当前栏位有卡牌
-            if (!(*cards).empty()) {
-                for(auto &card : *cards) {
-                    if(card && card->get_card_state()!=0&&card->getHP()>0) {
-                        card_info.push_back(card->toJson());
-                    }else{
-                        card_info.push_back(nullptr);
-                    }
-                } 
-            }else{
-                card_info.push_back(nullptr);
+        send_to_player(player_id, accept_response, raw);
+    }
+    
+    // 完整棋盘，按recipient的编码和卡牌格式拼接各卡牌缓存的片段，不可见的格子为null
+    // flat为true时是move_accepted的旧格式：所有栏位的卡牌按顺序放在一个扁平数组中，空栏位记一个null；
+    // 否则每个栏位一个数组，空栏位为空数组（opponent_move的格式）
+    std::string board_fragment(const std::string& recipient, const std::vector<std::vector<Card*>>& slots_cards,
+                               bool flat) {
+        const JoinOptions& options = seat_options_[recipient];
+        auto append_card = [&options](std::string& out, Card* card) {
+            if (card && card->get_card_state() != 0 && card->getHP() > 0) {
+                out += card->fragment(options.codec, options.compact_cards);
+            } else {
+                wire::append_null(options.codec, out);
             }
-            
+        };
+        std::string out;
+        if (flat) {
+            size_t count = 0;
+            for (const auto& slot : slots_cards) count += std::max<size_t>(1, slot.size());
+            wire::begin_array(options.codec, out, count);
+            size_t index = 0;
+            for (const auto& slot : slots_cards) {
+                if (slot.empty()) {
+                    wire::array_separator(options.codec, out, index++);
+                    wire::append_null(options.codec, out);
+                    continue;
+                }
+                for (Card* card : slot) {
+                    wire::array_separator(options.codec, out, index++);
+                    append_card(out, card);
+                }
+            }
+            wire::end_array(options.codec, out);
+            return out;
         }
-        
-        
-        accept_response["cards_played"] = card_info;
-
-        send_to_player(player_id, accept_response.dump());
-       
-        
-        // 使用简单的发布器替代ROS发布器
-        if (player_id == "player1") {
-            player1_pub_.publish(move_desc + " " + move_desc1, "player1_commands");
-        } else {
-            player2_pub_.publish(move_desc + " " + move_desc1, "player2_commands");
+        wire::begin_array(options.codec, out, slots_cards.size());
+        for (size_t i = 0; i < slots_cards.size(); ++i) {
+            const auto& slot = slots_cards[i];
+            wire::array_separator(options.codec, out, i);
+            wire::begin_array(options.codec, out, slot.size());
+            for (size_t j = 0; j < slot.size(); ++j) {
+                wire::array_separator(options.codec, out, j);
+                append_card(out, slot[j]);
+            }
+            wire::end_array(options.codec, out);
         }
+        wire::end_array(options.codec, out);
+        return out;
     }
-    
+
     void broadcast_game_start() {
         json response;
         response["type"] = "game_start";
         response["message"] = "Both players joined! Game starting...";
         response["last_player"] = last_player;
         
-        broadcast(response.dump());
-        Logger::info("Game started with both players");
+        broadcast(response);
+        LOG_INFO("game started", {{"room", room_id_}});
+        match_active_ = true;
+        afk_passes_.clear();
+        arm_turn_timer();
     }
     
 
@@ -809,6 +1776,7 @@ private:
         cur_player_bones=0;
         round_flag=0;
         character_HP_flag=0;
+        player_hp_=0;
         last_player=(dis(gen) == 0) ? "player1" : "player2";
         broadcast_game_start();
 
@@ -816,8 +1784,8 @@ private:
         json accept_response;
         accept_response["type"] = "player_hp";
         accept_response["message"]= 0;
-        send_to_player(player_idnex, accept_response.dump());
-        send_to_player(player_idnex_op, accept_response.dump());
+        send_to_player(player_idnex, accept_response);
+        send_to_player(player_idnex_op, accept_response);
 
         //发送骨头数量
         player_bonus={cur_player_bones, last_player_bones};
@@ -826,45 +1794,138 @@ private:
         bonus_response["type"] = "player_bonus";
         bonus_response["message"]=player_bonus;
         bonus_response["blood"]=xianjiing;
-        send_to_player(player_idnex, bonus_response.dump());
+        send_to_player(player_idnex, bonus_response);
 
         json bonus_response_op;
         bonus_response_op["type"] = "player_bonus";
         bonus_response_op["message"]=player_bonus;
         bonus_response_op["blood"]=xianjiing;
-        send_to_player(player_idnex_op, bonus_response_op.dump());
+        send_to_player(player_idnex_op, bonus_response_op);
     }
     
     
-    void send_to_player(const std::string& player_id, const std::string& message) {
+    // 每条下行消息带上座位内递增的seq并记入该座位的重发缓冲区；玩家断线期间只记录不发送
+    // raw为已按该座位编码拼好的字段（卡牌数组等），直接拼接到消息末尾
+    void send_to_player(const std::string& player_id, json message, const wire::RawFields& raw = {}) {
+        auto& outbox = outboxes_[player_id];
+        auto outbound = std::make_shared<OutboundMessage>();
+        outbound->seq = outbox.next_seq();
+        outbound->type = message.value("type", std::string());
+        outbound->codec = seat_options_[player_id].codec;
+        message["seq"] = outbound->seq;
+        {
+            TraceSpan span("serialize");
+            outbound->text = wire::splice_fields(outbound->codec, wire::encode(outbound->codec, message), raw);
+        }
+        outbox.record(outbound);
+
+        deliver(player_id, std::move(outbound));
+    }
+
+    // 处于CommitScope内且该座位开启了batch时先暂存，否则直接进入下行队列
+    void deliver(const std::string& player_id, std::shared_ptr<const OutboundMessage> outbound) {
         auto it = player_connections_.find(player_id);
-        if (it != player_connections_.end()) {
-            auto hdl = it->second;
-            try {
-                ws_server_.send(hdl, message, websocketpp::frame::opcode::text);
-            } catch (const websocketpp::exception& e) {
-                Logger::error("WebSocket send error: " + std::string(e.what()));
+        if (it == player_connections_.end() || disconnected_players_.count(player_id) != 0) {
+            return;
+        }
+        if (commit_depth_ > 0 && seat_options_[player_id].batch) {
+            pending_commit_[player_id].push_back(std::move(outbound));
+            return;
+        }
+        TraceSpan span("send");
+        FrameSender::send(ws_server_, it->second, std::move(outbound));
+    }
+
+    // 每个接收方只发一帧：单条消息原样发送，多条消息拼接为
+    // {"type":"turn_commit","messages":[...]}，messages保持产生顺序，各自带有原来的seq；
+    // 二进制编码的连接按CBOR/MessagePack格式拼接
+    void flush_commit() {
+        ScopedTimer timer(metrics_.stage(GameMetrics::Stage::commit));
+        TraceSpan span("commit");
+        for (auto& [player_id, messages] : pending_commit_) {
+            if (messages.empty()) continue;
+            auto it = player_connections_.find(player_id);
+            if (it == player_connections_.end() || disconnected_players_.count(player_id) != 0) {
+                messages.clear();
+                continue;
+            }
+            if (messages.size() == 1) {
+                TraceSpan span("send");
+                FrameSender::send(ws_server_, it->second, std::move(messages.front()));
+                messages.clear();
+                continue;
+            }
+            WireCodec codec = seat_options_[player_id].codec;
+            std::vector<std::string> transcoded;
+            transcoded.reserve(messages.size());
+            std::vector<const std::string*> items;
+            items.reserve(messages.size());
+            for (auto& message : messages) {
+                if (message->codec == codec) {
+                    items.push_back(&message->text);
+                } else {
+                    transcoded.push_back(wire::transcode(message->codec, codec, message->text));
+                    items.push_back(&transcoded.back());
+                }
             }
+            auto envelope = std::make_shared<OutboundMessage>();
+            envelope->type = "turn_commit";
+            envelope->codec = codec;
+            envelope->text = wire::encode_envelope(codec, envelope->type, items);
+            messages.clear();
+            TraceSpan span("send");
+            FrameSender::send(ws_server_, it->second, std::move(envelope));
         }
     }
+
+    // 一条上行消息的处理范围，可嵌套，最外层结束时合并下发
+    struct CommitScope {
+        GameRoom& room;
+        explicit CommitScope(GameRoom& r) : room(r) { ++room.commit_depth_; }
+        ~CommitScope() {
+            if (--room.commit_depth_ == 0) room.flush_commit();
+        }
+    };
     
-    void broadcast(const std::string& message) {
-        std::lock_guard<std::mutex> lock(connections_mutex_);
-        for (auto hdl : connections_) {
-            try {
-                ws_server_.send(hdl, message, websocketpp::frame::opcode::text);
-            } catch (const websocketpp::exception& e) {
-                Logger::error("WebSocket broadcast error: " + std::string(e.what()));
-            }
+    // 只广播给本房间内的玩家
+    void broadcast(const json& message) {
+        for (auto& [pid, hdl] : player_connections_) {
+            send_to_player(pid, message);
         }
     }
 
-private:
-   // WebSocket服务器
-    server ws_server_;
-    std::thread ws_thread_;
-    std::set<websocketpp::connection_hdl, std::owner_less<websocketpp::connection_hdl>> connections_;
-    std::mutex connections_mutex_;
+    uint64_t seed_;                 // 对局种子，随快照保存
+    std::string room_id_;
+    server& ws_server_;
+    websocketpp::lib::asio::io_service::strand strand_;
+    EventBus& events_;
+    const GameMetrics& metrics_;
+    TimerService& timers_;
+    const RoomTimeouts timeouts_;
+    // 计时器：代数在每次重新安排或取消时递增，到期回调投递到strand后核对代数，过期的回调直接忽略
+    struct SeatTimer {
+        TimerService::Handle handle;
+        uint64_t generation = 0;
+    };
+    bool match_active_ = false;     // 对局进行中（game_start之后、game_end之前）
+    std::string turn_seat_;          // 当前计时的座位
+    TimerService::Handle turn_timer_;
+    uint64_t turn_generation_ = 0;
+    TimerService::Handle new_round_timer_;
+    uint64_t new_round_generation_ = 0;
+    std::unordered_map<std::string, SeatTimer> grace_timers_;
+    std::unordered_map<std::string, int> afk_passes_; // 座位 -> 连续被自动跳过的回合数
+    bool auto_passing_ = false;
+    bool frozen_ = false;           // 已转存，见suspend()
+    // 命令日志：本房间已记录的命令序号、最外层命令嵌套深度、上次快照后的命令数，重放中和回收后不记录
+    Journal* journal_;
+    uint64_t journal_seq_ = 0;
+    int journal_depth_ = 0;
+    int commands_since_checkpoint_ = 0;
+    bool replaying_ = false;
+    bool journal_closed_ = false;
+    // 由I/O线程修改，单独占一个缓存行，避免与房间线程读写的对局状态互相干扰
+    alignas(kCacheLineSize) std::atomic<int> online_{0};
 
     std::vector<std::vector<Card*>> slots_cards;
     std::unordered_map<std::string, std::vector<std::vector<Card*>>> last_slots_cards;
@@ -887,20 +1948,985 @@ private:
 
     std::unordered_map<std::string, websocketpp::connection_hdl> player_connections_;
     std::set<std::string> disconnected_players_; // 新增：存储断开连接的玩家
+    std::set<std::string> new_round_requests_;
+    std::unordered_map<std::string, ResendBuffer> outboxes_; // 座位 -> 已发下行消息
+    std::unordered_map<std::string, JoinOptions> seat_options_; // 座位 -> 客户端能力
+    std::unordered_map<std::string, std::string> seat_tokens_;  // 座位 -> 重连令牌
+    struct SeatBoards {
+        BoardSync own;      // move_accepted中的己方棋盘
+        BoardSync opponent; // opponent_move中的对方棋盘
+    };
+    std::unordered_map<std::string, SeatBoards> board_sync_; // 接收方座位 -> 增量同步状态
+    std::unordered_map<std::string, std::vector<std::shared_ptr<const OutboundMessage>>> pending_commit_;
+    int commit_depth_ = 0;
+    int player_hp_ = 0; // 最近一次对战结算后的血量差
 
     // std::set<int> played_numbers_;
     std::unordered_multiset<Card*> played_cards_;
     json card_json;
 
-    std::mutex game_mutex_;
+    int character_HP_flag = 0;
+};
+
+//1230,骨头的郊狼方第一栏过了一回合就没了，先手方每选卡片直接结束导致卡牌栏错位了
+//多房间：GameServer只负责连接与房间路由，对局状态全部放在GameRoom中
+//消息热路径：连接对象上取房间 -> 投递到房间strand，不经过任何全局锁；房间表只在加入和回收房间时加锁
+class GameServer {
+public:
+    explicit GameServer(const ServerConfig& config = ServerConfig())
+        : config_(config),
+          game_metrics_(metrics_),
+          journal_(open_journal()),
+          room_context_{events_, game_metrics_, timers_, config_.room_timeouts(), journal_.get()},
+          matchmaker_([this](const Matchmaker::Ticket& first, const Matchmaker::Ticket& second) {
+                          on_match(first, second);
+                      },
+                      [](const Matchmaker::Stats& stats) {
+                          LOG_INFO("matchmaking", {{"depth", stats.depth},
+                                                   {"pairs", stats.matched_pairs},
+                                                   {"wait_us_p50", stats.p50_wait_us},
+                                                   {"p90", stats.p90_wait_us},
+                                                   {"p99", stats.p99_wait_us},
+                                                   {"max", stats.max_wait_us}});
+                      }) {
+        Logger::set_level(config_.log_level);
+        SlowTurnLog::shared().configure(config_.slow_turn_ms * 1000, config_.slow_turn_log);
+        OutboundQueue::limits().budget_bytes = config_.outbound_budget_bytes;
+        TunedDeflate::Settings& deflate = TunedDeflate::settings();
+        deflate.enabled = config_.deflate;
+        deflate.window_bits = config_.deflate_window_bits;
+        deflate.mem_level = config_.deflate_mem_level;
+        deflate.level = config_.deflate_level;
+        deflate.min_size = config_.deflate_min_size;
+        register_metrics();
+        schedule_compression_report();
+
+        // WebSocket服务器设置
+        ws_server_.init_asio();
+        set_handlers(ws_server_);
+        
+        if (config_.shards > 0) {
+            shards_ = std::make_unique<ShardScheduler>(config_.shards, config_.pin_cpus);
+            Logger::info("Room shards: " + std::to_string(config_.shards) +
+                         (config_.pin_cpus ? " (pinned)" : ""));
+        }
+
+        if (config_.workers > 1) {
+            // 多个工作进程共享同一端口，由内核在进程间分配新连接
+            ws_server_.set_tcp_pre_bind_handler([](server::acceptor_ptr acceptor) {
+                int reuse = 1;
+                if (setsockopt(acceptor->native_handle(), SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) != 0) {
+                    Logger::error("setsockopt(SO_REUSEPORT) failed");
+                }
+                return websocketpp::lib::error_code();
+            });
+
+            // 本进程独占的路由端口，与公共端口共用同一个io_context和处理器
+            uint16_t route_port = config_.route_port(config_.worker_index);
+            route_server_ = std::make_unique<server>();
+            route_server_->init_asio(&ws_server_.get_io_service());
+            set_handlers(*route_server_);
+            route_server_->set_reuse_addr(true);
+            route_server_->listen(route_port);
+            route_server_->start_accept();
+            Logger::info("Worker " + std::to_string(config_.worker_index) + "/" + std::to_string(config_.workers) +
+                         " route port " + std::to_string(route_port));
+        }
+
+        // 上一个进程排空时转存的房间，以及崩溃时日志中的房间，在开始接受连接之前恢复
+        restore_rooms();
+        recover_from_journal();
+
+        // 热重启时旧进程的连接可能还处于TIME_WAIT
+        ws_server_.set_reuse_addr(true);
+        ws_server_.listen(config_.port);
+        ws_server_.start_accept();
+        
+        // 多个后台线程运行同一个io_context；websocketpp在多线程配置下每个连接的处理器经由该连接的strand执行，
+        // 同一连接的消息仍按到达顺序处理
+        size_t io_threads = config_.io_threads;
+        if (io_threads == 0) {
+            io_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        for (size_t i = 0; i < io_threads; ++i) {
+            ws_threads_.emplace_back([this]() {
+                ws_server_.run();
+            });
+        }
+        
+        Logger::info("Game server started on port " + std::to_string(config_.port) +
+                     " with " + std::to_string(io_threads) + " I/O threads");
+    }
     
-    // 替代ROS发布器
-    SimplePublisher player1_pub_;
-    SimplePublisher player2_pub_;
+    ~GameServer() {
+        // 先停定时器线程，之后不会再有回调投递到房间
+        timers_.stop();
+        if (route_server_) {
+            route_server_->stop_listening();
+        }
+        ws_server_.stop();
+        
+        for (auto& ws_thread : ws_threads_) {
+            if (ws_thread.joinable()) {
+                ws_thread.join();
+            }
+        }
+        if (shards_) {
+            shards_->stop();
+        }
+        // 房间不再执行，剩余日志落盘后停止；换段回调用到房间表，必须在成员析构之前停
+        if (journal_) {
+            journal_->stop();
+        }
+    }
+
+    // 排空：不再接受加入，停止监听让新进程接管端口，各房间处理完已投递的消息后转存并冻结，
+    // 状态写入state_file后关闭玩家连接，最多等待drain_timeout_ms。只执行一次，返回后即可析构
+    void drain() {
+        if (draining_.exchange(true)) return;
+        auto started = std::chrono::steady_clock::now();
+        websocketpp::lib::error_code ec;
+        ws_server_.stop_listening(ec);
+        if (route_server_) {
+            route_server_->stop_listening(ec);
+        }
+
+        std::vector<std::shared_ptr<GameRoom>> rooms;
+        {
+            std::lock_guard<std::mutex> lock(rooms_mutex_);
+            for (const auto& [id, room] : rooms_) rooms.push_back(room);
+        }
+        // 转存任务排在各房间strand上已有消息之后，进行中的回合先处理完
+        std::vector<std::future<json>> pending;
+        for (const auto& room : rooms) {
+            auto promise = std::make_shared<std::promise<json>>();
+            pending.push_back(promise->get_future());
+            room->post([room, promise]() {
+                try {
+                    promise->set_value(room->suspend());
+                } catch (const std::exception& e) {
+                    LOG_ERROR("room suspend failed", {{"room", room->id()}, {"error", e.what()}});
+                    promise->set_value(nullptr);
+                }
+            });
+        }
+        json file;
+        file["version"] = room_state::kFormatVersion;
+        file["catalog_version"] = CardCatalog::shared().version();
+        file["rooms"] = json::array();
+        for (auto& state : pending) {
+            json room = state.get();
+            if (!room.is_null()) file["rooms"].push_back(std::move(room));
+        }
+
+        std::string path = config_.state_path();
+        if (!path.empty()) {
+            std::string error;
+            if (room_state::write_file(path, file.dump(), error)) {
+                LOG_INFO("room state saved", {{"path", path}, {"rooms", file["rooms"].size()}});
+            } else {
+                LOG_ERROR("room state not saved", {{"path", path}, {"error", error}});
+            }
+        }
+
+        auto deadline = started + std::chrono::milliseconds(config_.drain_timeout_ms);
+        while (connection_count_.load(std::memory_order_relaxed) > 0 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        LOG_INFO("drained", {{"rooms", file["rooms"].size()},
+                             {"open_connections", connection_count_.load(std::memory_order_relaxed)},
+                             {"ms", std::chrono::duration_cast<std::chrono::milliseconds>(
+                                        std::chrono::steady_clock::now() - started).count()}});
+        Logger::flush();
+    }
+
+    // 录像、统计、观战等通过总线订阅游戏事件，例如 events().subscribe<GameEndEvent>("replay", handler)
+    EventBus& events() { return events_; }
+
+private:
+    // 房间数、连接数、队列深度等按需采样的指标，以及已有的匹配、下行队列、压缩和事件总线统计
+    void register_metrics() {
+        metrics_.gauge("xemk_rooms", "Rooms currently open.", "", [this]() {
+            std::lock_guard<std::mutex> lock(rooms_mutex_);
+            return static_cast<double>(rooms_.size());
+        });
+        metrics_.gauge("xemk_connections", "Open WebSocket connections.", "", [this]() {
+            return static_cast<double>(connection_count_.load(std::memory_order_relaxed));
+        });
+        metrics_.gauge("xemk_matchmaking_depth", "Players waiting in the matchmaking queue.", "", [this]() {
+            return static_cast<double>(matchmaker_.stats().depth);
+        });
+        metrics_.counter("xemk_matched_pairs_total", "Pairs formed by the matchmaker.", "", [this]() {
+            return static_cast<double>(matchmaker_.stats().matched_pairs);
+        });
+        metrics_.gauge("xemk_timers_pending", "Room timers armed and not yet expired.", "", [this]() {
+            return static_cast<double>(timers_.pending());
+        });
+        metrics_.histogram("xemk_matchmaking_wait_seconds", "Time players waited in the matchmaking queue.", "",
+                           matchmaker_.wait_histogram());
+
+        if (journal_) {
+            const Journal& journal = *journal_;
+            metrics_.histogram("xemk_journal_fsync_seconds", "Time spent in fdatasync per journal group commit.", "",
+                               journal.fsync_histogram());
+            metrics_.counter("xemk_journal_records_total", "Records written to the room command journal.", "",
+                             [&journal]() { return static_cast<double>(journal.records()); });
+            metrics_.counter("xemk_journal_commits_total", "Journal group commits (one write and fdatasync each).", "",
+                             [&journal]() { return static_cast<double>(journal.commits()); });
+            metrics_.counter("xemk_journal_bytes_total", "Bytes written to the room command journal.", "",
+                             [&journal]() { return static_cast<double>(journal.bytes()); });
+            metrics_.counter("xemk_journal_errors_total", "Journal write, fdatasync and rotation failures.", "",
+                             [&journal]() { return static_cast<double>(journal.errors()); });
+            metrics_.gauge("xemk_journal_backlog", "Journal records queued and not yet committed.", "",
+                           [&journal]() { return static_cast<double>(journal.backlog()); });
+        }
+
+        const OutboundQueue::GlobalStats& outbound = OutboundQueue::global_stats();
+        metrics_.gauge("xemk_outbound_queued_bytes", "Bytes waiting in per-connection outbound queues.", "",
+                       [&outbound]() { return static_cast<double>(outbound.queued_bytes.load(std::memory_order_relaxed)); });
+        metrics_.counter("xemk_outbound_coalesced_total", "Outbound frames replaced by a newer frame of the same type.", "",
+                         [&outbound]() { return static_cast<double>(outbound.coalesced.load(std::memory_order_relaxed)); });
+        metrics_.counter("xemk_outbound_shed_total", "Low-priority outbound frames dropped over budget.", "",
+                         [&outbound]() { return static_cast<double>(outbound.shed.load(std::memory_order_relaxed)); });
+        metrics_.counter("xemk_slow_disconnects_total", "Connections closed as slow consumers.", "",
+                         [&outbound]() { return static_cast<double>(outbound.slow_disconnects.load(std::memory_order_relaxed)); });
+        metrics_.collector([this](std::string& out) {
+            std::string samples;
+            for_each_seated_connection([&samples](const SeatBinding& binding, const server::connection_ptr& con) {
+                MetricsRegistry::append_sample(samples, "xemk_outbound_connection_bytes",
+                                               "room=\"" + MetricsRegistry::escape_label(binding.room->id()) +
+                                                   "\",seat=\"" + binding.seat + "\"",
+                                               static_cast<double>(con->outbound.buffered_bytes()));
+            });
+            if (samples.empty()) return;
+            out += "# HELP xemk_outbound_connection_bytes Bytes waiting in each seated connection's outbound queue.\n";
+            out += "# TYPE xemk_outbound_connection_bytes gauge\n";
+            out += samples;
+        });
+        // 直方图只有全局分布，按座位导出最近一次往返时间便于定位个别玩家的网络问题
+        metrics_.collector([this](std::string& out) {
+            std::string samples;
+            for_each_seated_connection([&samples](const SeatBinding& binding, const server::connection_ptr& con) {
+                int64_t rtt = con->rtt_us.load(std::memory_order_relaxed);
+                if (rtt < 0) return;
+                MetricsRegistry::append_sample(samples, "xemk_player_rtt_seconds",
+                                               "room=\"" + MetricsRegistry::escape_label(binding.room->id()) +
+                                                   "\",seat=\"" + binding.seat + "\"",
+                                               static_cast<double>(rtt) / 1e6);
+            });
+            if (samples.empty()) return;
+            out += "# HELP xemk_player_rtt_seconds Most recent heartbeat round-trip time of each seated connection.\n";
+            out += "# TYPE xemk_player_rtt_seconds gauge\n";
+            out += samples;
+        });
+
+        metrics_.collector([](std::string& out) {
+            auto stats = CompressionStats::snapshot();
+            if (stats.empty()) return;
+            out += "# HELP xemk_compression_bytes_total Outbound payload bytes before and after permessage-deflate.\n";
+            out += "# TYPE xemk_compression_bytes_total counter\n";
+            for (const auto& s : stats) {
+                MetricsRegistry::append_sample(out, "xemk_compression_bytes_total",
+                                               "type=\"" + s.type + "\",direction=\"in\"", static_cast<double>(s.bytes_in));
+                MetricsRegistry::append_sample(out, "xemk_compression_bytes_total",
+                                               "type=\"" + s.type + "\",direction=\"out\"", static_cast<double>(s.bytes_out));
+            }
+            out += "# HELP xemk_compression_seconds_total Time spent compressing outbound payloads.\n";
+            out += "# TYPE xemk_compression_seconds_total counter\n";
+            for (const auto& s : stats) {
+                MetricsRegistry::append_sample(out, "xemk_compression_seconds_total", "type=\"" + s.type + "\"",
+                                               s.nanos / 1e9);
+            }
+        });
+        metrics_.collector([this](std::string& out) {
+            auto stats = events_.stats();
+            if (stats.empty()) return;
+            out += "# HELP xemk_event_subscriber_events_total Game events delivered to or dropped for each subscriber.\n";
+            out += "# TYPE xemk_event_subscriber_events_total counter\n";
+            for (const auto& s : stats) {
+                MetricsRegistry::append_sample(out, "xemk_event_subscriber_events_total",
+                                               "subscriber=\"" + s.name + "\",result=\"delivered\"",
+                                               static_cast<double>(s.delivered));
+                MetricsRegistry::append_sample(out, "xemk_event_subscriber_events_total",
+                                               "subscriber=\"" + s.name + "\",result=\"dropped\"",
+                                               static_cast<double>(s.dropped));
+            }
+        });
+    }
+
+    void set_handlers(server& endpoint) {
+        endpoint.set_open_handler(bind(&GameServer::on_open, this, ::_1));
+        endpoint.set_close_handler(bind(&GameServer::on_close, this, ::_1));
+        endpoint.set_message_handler(bind(&GameServer::on_message, this, ::_1, ::_2));
+        endpoint.set_validate_handler(bind(&GameServer::on_validate, this, ::_1));
+        endpoint.set_http_handler(bind(&GameServer::on_http, this, ::_1));
+        endpoint.set_pong_handler(bind(&GameServer::on_pong, this, ::_1, ::_2));
+        endpoint.set_max_message_size(config_.max_message_bytes);
+    }
+
+    // 普通HTTP请求：GET /catalog 返回卡牌目录，带ETag，客户端可用If-None-Match命中缓存；GET /metrics 返回Prometheus指标
+    void on_http(websocketpp::connection_hdl hdl) {
+        server::connection_ptr con = ws_server_.get_con_from_hdl(hdl);
+        std::string path = con->get_resource().substr(0, con->get_resource().find('?'));
+
+        if (path == "/catalog") {
+            const CardCatalog& catalog = CardCatalog::shared();
+            static const std::string body = catalog.toJson().dump();
+            std::string etag = "\"" + catalog.version() + "\"";
+            con->append_header("ETag", etag);
+            con->append_header("Cache-Control", "public, max-age=0, must-revalidate");
+            if (con->get_request_header("If-None-Match") == etag) {
+                con->set_status(websocketpp::http::status_code::not_modified);
+                return;
+            }
+            con->append_header("Content-Type", "application/json; charset=utf-8");
+            con->set_body(body);
+            con->set_status(websocketpp::http::status_code::ok);
+            return;
+        }
+
+        if (path == "/metrics") {
+            con->append_header("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+            con->set_body(metrics_.render());
+            con->set_status(websocketpp::http::status_code::ok);
+            return;
+        }
+
+        con->set_status(websocketpp::http::status_code::not_found);
+        con->set_body("Not Found");
+    }
+
+    // 握手阶段协商编码：客户端请求xemk.cbor/xemk.msgpack子协议时改用二进制帧
+    bool on_validate(websocketpp::connection_hdl hdl) {
+        server::connection_ptr con = ws_server_.get_con_from_hdl(hdl);
+        con->codec = wire::negotiate(con->get_requested_subprotocols());
+        if (wire::is_binary(con->codec)) {
+            con->select_subprotocol(wire::subprotocol_name(con->codec));
+        }
+        return true;
+    }
+
+    // 房间归属：匹配产生的房间号带有 "w<进程编号>-" 前缀，其余房间号按哈希分配
+    size_t owner_of(const std::string& room_id) const {
+        if (config_.workers <= 1) return config_.worker_index;
+        if (room_id.size() > 2 && room_id[0] == 'w') {
+            size_t dash = room_id.find('-');
+            if (dash != std::string::npos && dash > 1 &&
+                std::all_of(room_id.begin() + 1, room_id.begin() + dash, ::isdigit)) {
+                size_t worker = std::stoul(room_id.substr(1, dash - 1));
+                if (worker < config_.workers) return worker;
+            }
+        }
+        return std::hash<std::string>()(room_id) % config_.workers;
+    }
+
+    std::string get_connection_info(websocketpp::connection_hdl hdl, server& server) {
+        server::connection_ptr con = server.get_con_from_hdl(hdl);
+        if (!con) return "Invalid connection";
+        
+        std::ostringstream info;
+        info << "IP: " << con->get_remote_endpoint()
+            << ", Resource: " << con->get_resource()
+            << ", Host: " << con->get_host();
+        
+        // 检查是否有查询参数
+        std::string query = con->get_uri()->get_query();
+        if (!query.empty()) {
+            info << ", Query: " << query;
+        }
+        
+        return info.str();
+    }
+    void on_open(websocketpp::connection_hdl hdl) {
+        connection_count_.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex_);
+            open_connections_.insert(hdl);
+        }
+        server::connection_ptr con = ws_server_.get_con_from_hdl(hdl);
+        con->last_seen_us.store(steady_us(TurnTrace::Clock::now()), std::memory_order_relaxed);
+        schedule_heartbeat(hdl);
+        // 连接信息只在调试级别下拼接
+        LOG_DEBUG("new client connected", {{"info", get_connection_info(hdl, ws_server_)}});
+    }
+
+    // 导出指标时遍历已入座的连接；只读连接上的原子量和binding，不进入房间
+    template <typename Visit>
+    void for_each_seated_connection(Visit visit) {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        for (const auto& hdl : open_connections_) {
+            websocketpp::lib::error_code ec;
+            server::connection_ptr con = ws_server_.get_con_from_hdl(hdl, ec);
+            if (ec || !con) continue;
+            if (auto binding = std::atomic_load(&con->binding)) visit(*binding, con);
+        }
+    }
+
+    static int64_t steady_us(TurnTrace::Clock::time_point t) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+    }
+
+    // 每kCompressionReportInterval在定时器线程上记一次各消息类型的压缩率和耗时，没有压缩过的消息时不记
+    void schedule_compression_report() {
+        timers_.schedule(kCompressionReportInterval, [this]() {
+            if (Logger::enabled(LogLevel::info)) {
+                std::string compression = CompressionStats::summary();
+                if (!compression.empty()) {
+                    LOG_INFO("compression ratio/cost", {{"types", compression}});
+                }
+            }
+            schedule_compression_report();
+        });
+    }
+
+    // 半开的TCP连接不会触发on_close，由心跳发现：每个连接在共用的时间轮上挂一个周期定时器，
+    // 到期时投递到I/O线程检查上一个ping是否有回应并发出下一个ping；连接关闭后定时器最后触发一次即停止
+    void schedule_heartbeat(websocketpp::connection_hdl hdl) {
+        if (config_.ping_interval_ms == 0) return;
+        timers_.schedule(std::chrono::milliseconds(config_.ping_interval_ms), [this, hdl]() {
+            ws_server_.get_io_service().post([this, hdl]() { heartbeat(hdl); });
+        });
+    }
+
+    void heartbeat(websocketpp::connection_hdl hdl) {
+        websocketpp::lib::error_code ec;
+        server::connection_ptr con = ws_server_.get_con_from_hdl(hdl, ec);
+        if (ec || !con || con->get_state() != websocketpp::session::state::open) return;
+
+        int64_t now = steady_us(TurnTrace::Clock::now());
+        int64_t sent = con->ping_sent_us.load(std::memory_order_relaxed);
+        // 收到任何消息都说明连接还活着，不必等pong
+        if (sent != 0 && con->last_seen_us.load(std::memory_order_relaxed) < sent) {
+            int missed = con->missed_pongs.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (missed >= config_.max_missed_pongs) {
+                game_metrics_.heartbeat_reaped->inc();
+                LOG_WARN("closing unresponsive connection", {{"remote", con->get_remote_endpoint()},
+                                                             {"missed_pongs", missed},
+                                                             {"idle_ms", (now - con->last_seen_us.load(std::memory_order_relaxed)) / 1000}});
+                // 半开连接上关闭握手不会完成，websocketpp在握手超时后直接断开并调用on_close
+                con->close(websocketpp::close::status::going_away, "heartbeat timeout", ec);
+                return;
+            }
+        } else {
+            con->missed_pongs.store(0, std::memory_order_relaxed);
+        }
+
+        // payload带上发出时间，pong原样带回，往返时间不依赖ping_sent_us是否已被下一个ping覆盖
+        con->ping_sent_us.store(now, std::memory_order_relaxed);
+        con->ping(std::to_string(now), ec);
+        if (ec) {
+            LOG_DEBUG("ping failed", {{"remote", con->get_remote_endpoint()}, {"error", ec.message()}});
+            return;
+        }
+        schedule_heartbeat(hdl);
+    }
+
+    void on_pong(websocketpp::connection_hdl hdl, std::string payload) {
+        websocketpp::lib::error_code ec;
+        server::connection_ptr con = ws_server_.get_con_from_hdl(hdl, ec);
+        if (ec || !con) return;
+        int64_t now = steady_us(TurnTrace::Clock::now());
+        con->last_seen_us.store(now, std::memory_order_relaxed);
+        con->ping_sent_us.store(0, std::memory_order_relaxed);
+        con->missed_pongs.store(0, std::memory_order_relaxed);
+
+        int64_t sent = 0;
+        auto result = std::from_chars(payload.data(), payload.data() + payload.size(), sent);
+        if (result.ec != std::errc() || sent <= 0 || sent > now) return; // 不是本服务器发出的ping
+        int64_t rtt = now - sent;
+        con->rtt_us.store(rtt, std::memory_order_relaxed);
+        game_metrics_.rtt_seconds->record(static_cast<uint64_t>(rtt));
+        if (Logger::enabled(LogLevel::debug)) {
+            auto binding = std::atomic_load(&con->binding);
+            LOG_DEBUG("pong", {{"player", binding ? binding->seat : std::string()}, {"rtt_us", rtt}});
+        }
+    }
     
-    // 定时器控制
-    std::thread game_timer_thread_;
-    std::atomic<bool> running_{true};
+    void on_close(websocketpp::connection_hdl hdl) {
+        connection_count_.fetch_sub(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex_);
+            open_connections_.erase(hdl);
+        }
+        
+        // 检查是否是已注册的玩家断开连接
+        server::connection_ptr con = ws_server_.get_con_from_hdl(hdl);
+        if (con) {
+            if (auto ticket = std::atomic_exchange(&con->ticket, std::shared_ptr<MatchTicket>())) {
+                Matchmaker::cancel(ticket);
+            }
+            // 与匹配线程的入座互斥：谁交换到非空binding谁负责离开房间
+            if (auto binding = std::atomic_exchange(&con->binding, std::shared_ptr<SeatBinding>())) {
+                leave_room(hdl, binding);
+            }
+        }
+        
+        LOG_DEBUG("client disconnected");
+    }
+    
+    void on_message(websocketpp::connection_hdl hdl, server::message_ptr msg) {
+        auto arrived = TurnTrace::Clock::now();
+        try {
+            server::connection_ptr con = ws_server_.get_con_from_hdl(hdl);
+            con->last_seen_us.store(steady_us(arrived), std::memory_order_relaxed);
+            WireCodec codec = WireCodec::json;
+            if (msg->get_opcode() == websocketpp::frame::opcode::binary) {
+                if (!wire::is_binary(con->codec)) {
+                    game_metrics_.frames_rejected->inc();
+                    LOG_WARN("binary frame on a connection without a binary subprotocol",
+                             {{"remote", con->get_remote_endpoint()}});
+                    return;
+                }
+                codec = con->codec;
+            }
+            // 流式解析直接得到所需字段，格式错误或超出上限的帧在解析中途即被丢弃
+            auto payload = std::make_shared<InboundMessage>();
+            std::string error;
+            bool parsed = InboundMessage::parse(codec, msg->get_payload(), *payload, error);
+            auto parsed_at = TurnTrace::Clock::now();
+            game_metrics_.stage(GameMetrics::Stage::parse)->record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(parsed_at - arrived).count()));
+            if (!parsed) {
+                game_metrics_.frames_rejected->inc();
+                LOG_WARN("rejected frame", {{"remote", con->get_remote_endpoint()}, {"error", error}});
+                return;
+            }
+            const std::string& type = payload->type;
 
-    int character_HP_flag = 0;
-};
\ No newline at end of file
+            // 按类型计时放在这里而不是房间里：player_join不进房间strand，自动出牌代发的消息也不应计入
+            if (payload->type_id == protocol::MessageType::player_join) {
+                ScopedTimer timer(game_metrics_.message(payload->type_id));
+                handle_player_join(hdl, con, *payload);
+                return;
+            }
+            if (payload->type_id == protocol::MessageType::unknown) {
+                game_metrics_.frames_rejected->inc();
+                LOG_WARN("unknown message type", {{"type", type}});
+                return;
+            }
+
+            // 其余消息按连接找到所属房间和座位
+            auto binding = std::atomic_load(&con->binding);
+            if (!binding) {
+                LOG_WARN("message from a connection that has not joined a room", {{"type", type}});
+                return;
+            }
+            auto room = binding->room;
+            // 轨迹从收到帧开始计时，随消息投递到房间strand；慢回合日志关闭时不分配轨迹，TraceSpan不做任何事
+            std::shared_ptr<TurnTrace> trace;
+            if (SlowTurnLog::shared().enabled()) {
+                trace = std::make_shared<TurnTrace>(arrived);
+                trace->add("parse", arrived, parsed_at);
+            }
+            LatencyHistogram* strand_wait = game_metrics_.stage(GameMetrics::Stage::strand_wait);
+            LatencyHistogram* handling = game_metrics_.message(payload->type_id);
+            room->post([room, binding, hdl, payload = std::move(payload), trace, strand_wait, handling,
+                        queued = TurnTrace::Clock::now()]() {
+                auto started = TurnTrace::Clock::now();
+                strand_wait->record(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(started - queued).count()));
+                if (trace) trace->add("strand_wait", queued, started);
+                TurnTrace::Scope scope(trace.get());
+                try {
+                    {
+                        ScopedTimer timer(handling);
+                        TraceSpan span("on_message");
+                        room->on_message(binding->seat, hdl, *payload);
+                    }
+                    if (trace && SlowTurnLog::shared().is_slow(*trace)) {
+                        room->report_slow_turn(*trace, binding->seat, *payload);
+                    }
+                } catch (const std::exception& e) {
+                    LOG_ERROR("error processing message", {{"room", room->id()}, {"seat", binding->seat},
+                                                          {"error", e.what()}});
+                }
+            });
+            
+        } catch (const std::exception& e) {
+            LOG_ERROR("error processing message", {{"error", e.what()}});
+        }
+    }
+    void send_to_connection(websocketpp::connection_hdl hdl, const json& message) {
+        FrameSender::send(ws_server_, hdl, message);
+    }
+
+    // player_join携带room_id时直接进入指定房间（好友房和断线重连，重连可带last_seq只补发缺口），否则进入匹配队列
+    // player_id为期望的座位"player1"/"player2"，省略或"any"表示任意座位，实际座位在room_joined中返回
+    void handle_player_join(websocketpp::connection_hdl hdl, server::connection_ptr con, const InboundMessage& data) {
+        if (draining_.load(std::memory_order_relaxed)) {
+            json restart_response;
+            restart_response["type"] = "server_restart";
+            restart_response["message"] = "Server restarting, try again shortly";
+            send_to_connection(hdl, restart_response);
+            return;
+        }
+        std::string player_id = data.player_id;
+        if (player_id == "any") player_id.clear();
+        if (!player_id.empty() && player_id != "player1" && player_id != "player2") {
+            json error_response;
+            error_response["type"] = "error";
+            error_response["message"] = "player_id must be player1, player2 or any";
+            send_to_connection(hdl, error_response);
+            return;
+        }
+
+        // 同一连接重复加入时先撤销原来的排队或座位
+        if (auto ticket = std::atomic_exchange(&con->ticket, std::shared_ptr<MatchTicket>())) {
+            Matchmaker::cancel(ticket);
+        }
+        if (auto binding = std::atomic_exchange(&con->binding, std::shared_ptr<SeatBinding>())) {
+            leave_room(hdl, binding);
+        }
+
+        JoinOptions options = JoinOptions::from_message(data);
+        options.codec = con->codec;
+        std::string room_id = data.room_id;
+        if (room_id.empty()) {
+            auto ticket = std::make_shared<PlayerTicket>();
+            ticket->owner = hdl;
+            ticket->preferred_seat = player_id;
+            ticket->options = options;
+            std::atomic_store(&con->ticket, std::shared_ptr<MatchTicket>(ticket));
+            matchmaker_.enqueue(ticket);
+
+            json queued_response;
+            queued_response["type"] = "matchmaking_queued";
+            queued_response["queue_depth"] = matchmaker_.stats().depth;
+            send_to_connection(hdl, queued_response);
+            return;
+        }
+
+        if (player_id.empty()) {
+            json error_response;
+            error_response["type"] = "error";
+            error_response["message"] = "player_id is required when joining a room by id";
+            send_to_connection(hdl, error_response);
+            return;
+        }
+
+        // 房间属于其他工作进程时，让客户端改连该进程的路由端口
+        size_t owner = owner_of(room_id);
+        if (owner != config_.worker_index) {
+            json redirect_response;
+            redirect_response["type"] = "redirect";
+            redirect_response["room_id"] = room_id;
+            redirect_response["worker"] = owner;
+            redirect_response["port"] = config_.route_port(owner);
+            send_to_connection(hdl, redirect_response);
+            return;
+        }
+
+        std::shared_ptr<GameRoom> room;
+        {
+            std::lock_guard<std::mutex> lock(rooms_mutex_);
+            auto room_it = rooms_.find(room_id);
+            if (room_it != rooms_.end()) {
+                room = room_it->second;
+            } else {
+                room = create_room(room_id);
+            }
+            room->acquire_connection();
+        }
+        seat_connection(hdl, con, room, player_id, options);
+    }
+
+    // 匹配线程回调：为两名玩家新建房间并入座
+    void on_match(const Matchmaker::Ticket& first, const Matchmaker::Ticket& second) {
+        std::shared_ptr<GameRoom> room;
+        {
+            std::lock_guard<std::mutex> lock(rooms_mutex_);
+            // 客户端可能已按房间号开了同名房间，跳过正在使用的房间号，不覆盖其中的玩家
+            std::string room_id;
+            do {
+                room_id = room_prefix() + "m" + std::to_string(next_room_id_++);
+            } while (rooms_.count(room_id));
+            room = create_room(room_id);
+            room->acquire_connection();
+            room->acquire_connection();
+        }
+        for (auto [ticket, seat] : {std::make_pair(first, "player1"), std::make_pair(second, "player2")}) {
+            websocketpp::lib::error_code ec;
+            server::connection_ptr con = ws_server_.get_con_from_hdl(ticket->owner, ec);
+            // 配对后连接已不存在，或连接已撤销这次排队（断开或改为加入别的房间），对方会收到opponent_disconnected
+            if (ec || !con || ticket->closed.load() || std::atomic_load(&con->ticket) != ticket) {
+                if (room->release_connection() == 0) {
+                    release_room(room);
+                }
+                continue;
+            }
+            // 检查之后连接线程仍可能抢先入座：binding只从空发布，失败说明连接已在别的房间，撤销这里的入座
+            auto binding = std::make_shared<SeatBinding>(SeatBinding{room, seat});
+            const JoinOptions& options = std::static_pointer_cast<PlayerTicket>(ticket)->options;
+            room->post([room, hdl = ticket->owner, seat = binding->seat, options]() {
+                room->handle_player_join(hdl, seat, options);
+            });
+            std::shared_ptr<SeatBinding> expected;
+            if (!std::atomic_compare_exchange_strong(&con->binding, &expected, binding)) {
+                leave_room(ticket->owner, binding);
+                continue;
+            }
+            // 配对期间连接已断开：on_close可能没拿到binding，这里补一次离开；
+            // 只撤销自己发布的binding，连接已经重新加入时由加入处理负责离开这个房间
+            if (ticket->closed.load()) {
+                expected = binding;
+                if (std::atomic_compare_exchange_strong(&con->binding, &expected, std::shared_ptr<SeatBinding>())) {
+                    leave_room(ticket->owner, binding);
+                }
+            }
+        }
+    }
+
+    // 先投递入座再发布binding，保证之后的断开处理一定排在入座之后
+    void seat_connection(websocketpp::connection_hdl hdl, server::connection_ptr con,
+                         const std::shared_ptr<GameRoom>& room, const std::string& seat,
+                         const JoinOptions& options) {
+        room->post([room, hdl, seat, options]() {
+            room->handle_player_join(hdl, seat, options);
+        });
+        std::atomic_store(&con->binding, std::make_shared<SeatBinding>(SeatBinding{room, seat}));
+    }
+
+    void leave_room(websocketpp::connection_hdl hdl, const std::shared_ptr<SeatBinding>& binding) {
+        auto room = binding->room;
+        room->post([room, hdl, binding]() {
+            room->handle_player_disconnect(hdl, binding->seat);
+        });
+        if (room->release_connection() == 0) {
+            release_room(room);
+        }
+    }
+
+    // 房间内已无在线连接时回收房间；加锁后再次检查，避免与同时进行的加入冲突
+    void release_room(const std::shared_ptr<GameRoom>& room) {
+        std::lock_guard<std::mutex> lock(rooms_mutex_);
+        if (room->online() > 0) return;
+        auto room_it = rooms_.find(room->id());
+        if (room_it != rooms_.end() && room_it->second == room) {
+            rooms_.erase(room_it);
+            room->post([room]() { room->close_journal(); });
+            LOG_INFO("room closed", {{"room", room->id()}, {"rooms", rooms_.size()}});
+        }
+    }
+
+    std::string room_prefix() const {
+        return config_.workers > 1 ? "w" + std::to_string(config_.worker_index) + "-" : std::string();
+    }
+
+    // 读入上一个进程转存的房间；文件读入后改名为 .restored，同一份状态不会被恢复两次
+    // 恢复的房间没有在线连接，超过重连宽限仍无人重连时回收
+    void restore_rooms() {
+        std::string path = config_.state_path();
+        if (path.empty()) return;
+        std::string data, error;
+        if (!room_state::read_file(path, data, error)) {
+            if (!error.empty()) LOG_ERROR("room state not loaded", {{"path", path}, {"error", error}});
+            return;
+        }
+        std::rename(path.c_str(), (path + ".restored").c_str());
+
+        json file = json::parse(data, nullptr, false);
+        if (file.is_discarded() || file.value("version", 0) != room_state::kFormatVersion) {
+            LOG_ERROR("room state has an unknown format", {{"path", path}});
+            return;
+        }
+        if (file.value("catalog_version", std::string()) != CardCatalog::shared().version()) {
+            LOG_WARN("card catalog changed, saved rooms dropped", {{"path", path}});
+            return;
+        }
+
+        std::vector<std::shared_ptr<GameRoom>> restored;
+        {
+            std::lock_guard<std::mutex> lock(rooms_mutex_);
+            for (const auto& state : file["rooms"]) {
+                std::string room_id = state.value("id", std::string());
+                if (room_id.empty() || rooms_.count(room_id)) continue;
+                auto room = create_room(room_id, false);
+                room->post([room, state]() {
+                    try {
+                        room->restore(state);
+                    } catch (const std::exception& e) {
+                        LOG_ERROR("room restore failed", {{"room", room->id()}, {"error", e.what()}});
+                    }
+                });
+                restored.push_back(room);
+                reserve_room_id(room_id);
+            }
+        }
+        LOG_INFO("rooms restored", {{"path", path}, {"rooms", restored.size()}});
+        release_unclaimed(restored);
+    }
+
+    // 崩溃恢复：读入上一个进程留下的日志段，每个房间从最近一次快照开始重放其后的命令
+    // 已由state_file恢复的房间（正常排空）和已回收的房间跳过；恢复后所有房间在当前段写快照，旧段随之删除
+    void recover_from_journal() {
+        if (!journal_) return;
+        struct Tail {
+            json snapshot;
+            std::vector<json> commands;
+        };
+        std::map<std::string, Tail> tails;
+        uint64_t current = journal_->segment();
+        const std::string catalog = CardCatalog::shared().version();
+        size_t records = 0;
+        for (const auto& segment : Journal::list_segments(journal_->options().dir)) {
+            if (segment.number >= current) break;
+            records += Journal::read_segment(segment.path, [&](const json& record) {
+                std::string room_id = record.value("room", std::string());
+                if (room_id.empty()) return;
+                if (record.contains("snapshot")) {
+                    if (record.value("catalog", std::string()) != catalog) {
+                        tails.erase(room_id);
+                        return;
+                    }
+                    Tail& tail = tails[room_id];
+                    tail.snapshot = record["snapshot"];
+                    tail.commands.clear();
+                } else if (record.contains("cmd")) {
+                    auto it = tails.find(room_id);
+                    if (it != tails.end()) it->second.commands.push_back(record);
+                } else if (record.contains("closed")) {
+                    tails.erase(room_id);
+                }
+            });
+        }
+
+        std::vector<std::shared_ptr<GameRoom>> recovered;
+        size_t commands = 0;
+        {
+            std::lock_guard<std::mutex> lock(rooms_mutex_);
+            for (auto& [room_id, tail] : tails) {
+                if (rooms_.count(room_id)) continue;
+                auto room = create_room(room_id, false);
+                commands += tail.commands.size();
+                room->post([room, tail = std::move(tail)]() {
+                    try {
+                        room->replay(tail.snapshot, tail.commands);
+                    } catch (const std::exception& e) {
+                        LOG_ERROR("room replay failed", {{"room", room->id()}, {"error", e.what()}});
+                    }
+                });
+                recovered.push_back(room);
+                reserve_room_id(room_id);
+            }
+        }
+        if (records > 0) {
+            LOG_INFO("rooms recovered from journal", {{"dir", journal_->options().dir}, {"records", records},
+                                                      {"rooms", recovered.size()}, {"commands", commands}});
+        }
+        release_unclaimed(recovered);
+        checkpoint_rooms(current);
+    }
+
+    // 所有房间在segment段中各写一次快照后，更早的段不再需要。在日志后台线程（换段）或构造函数中调用
+    void checkpoint_rooms(uint64_t segment) {
+        std::vector<std::shared_ptr<GameRoom>> rooms;
+        {
+            std::lock_guard<std::mutex> lock(rooms_mutex_);
+            for (const auto& [id, room] : rooms_) rooms.push_back(room);
+        }
+        auto remaining = std::make_shared<std::atomic<size_t>>(rooms.size() + 1);
+        Journal* journal = journal_.get();
+        auto done = [journal, remaining, segment]() {
+            if (remaining->fetch_sub(1, std::memory_order_acq_rel) == 1) journal->retire_before(segment);
+        };
+        for (const auto& room : rooms) {
+            room->post([room, done]() {
+                room->checkpoint();
+                done();
+            });
+        }
+        done();
+    }
+
+    // 匹配房间号继续往后编号，不与恢复的房间重复。调用方需持有rooms_mutex_
+    void reserve_room_id(const std::string& room_id) {
+        std::string prefix = room_prefix() + "m";
+        if (room_id.compare(0, prefix.size(), prefix) != 0) return;
+        const char* digits = room_id.c_str() + prefix.size();
+        uint64_t number = 0;
+        auto result = std::from_chars(digits, room_id.c_str() + room_id.size(), number);
+        if (result.ec == std::errc() && *result.ptr == '\0') {
+            next_room_id_ = std::max(next_room_id_, number + 1);
+        }
+    }
+
+    // 恢复的房间没有在线连接，超过重连宽限仍无人重连时回收
+    void release_unclaimed(const std::vector<std::shared_ptr<GameRoom>>& rooms) {
+        auto claim_window = config_.room_timeouts().reconnect_grace + std::chrono::seconds(1);
+        for (const auto& room : rooms) {
+            std::weak_ptr<GameRoom> weak = room;
+            timers_.schedule(claim_window, [this, weak]() {
+                ws_server_.get_io_service().post([this, weak]() {
+                    if (auto room = weak.lock()) release_room(room);
+                });
+            });
+        }
+    }
+
+    // 调用方需持有rooms_mutex_。新开的房间先写一次初始快照，恢复的房间在restore/replay之后自己写
+    std::shared_ptr<GameRoom> create_room(const std::string& room_id, bool fresh = true) {
+        auto& executor = shards_ ? shards_->shard_for(room_id).io_service() : ws_server_.get_io_service();
+        auto room = std::make_shared<GameRoom>(room_id, ws_server_, executor, room_context_, room_seed(room_id));
+        rooms_[room_id] = room;
+        if (fresh && journal_) {
+            room->post([room]() { room->checkpoint(); });
+        }
+        LOG_INFO("room created", {{"room", room_id}, {"rooms", rooms_.size()}, {"seed", room->seed()}});
+        return room;
+    }
+
+    // 对局种子随房间快照进入日志，离线重放从快照开始即可复现同一局面
+    uint64_t room_seed(const std::string& room_id) {
+        if (config_.seed != 0) return derive_seed(config_.seed, std::hash<std::string>()(room_id));
+        std::random_device rd;
+        return (static_cast<uint64_t>(rd()) << 32) | rd();
+    }
+
+    std::unique_ptr<Journal> open_journal() {
+        std::string dir = config_.journal_path();
+        if (dir.empty()) return nullptr;
+        Journal::Options options;
+        options.dir = dir;
+        options.segment_bytes = config_.journal_segment_mb << 20;
+        options.commit_interval = std::chrono::microseconds(config_.journal_commit_us);
+        options.snapshot_every = config_.snapshot_every;
+        // 换段后所有房间在新段写一次快照，之后删除旧段
+        return std::make_unique<Journal>(options, [this](uint64_t segment) { checkpoint_rooms(segment); });
+    }
+
+private:
+    static constexpr auto kCompressionReportInterval = std::chrono::seconds(10);
+
+    ServerConfig config_;
+    // 游戏事件总线和指标，房间持有其引用，必须在房间表和分片之前构造、之后销毁
+    EventBus events_;
+    MetricsRegistry metrics_;
+    GameMetrics game_metrics_;
+    // 所有房间共用一个时间轮，不为每个房间开线程
+    TimerService timers_;
+    // 命令日志，房间持有其指针；由析构函数显式停止
+    std::unique_ptr<Journal> journal_;
+    RoomContext room_context_;
+   // WebSocket服务器
+    server ws_server_;
+    std::unique_ptr<server> route_server_; // 多进程模式下本进程独占的路由端口
+    std::vector<std::thread> ws_threads_;
+    // 分片模式下的房间线程，必须在房间表之前构造、之后销毁
+    std::unique_ptr<ShardScheduler> shards_;
+    // 每个I/O线程都会修改，独占缓存行
+    alignas(kCacheLineSize) std::atomic<size_t> connection_count_{0};
+    std::atomic<bool> draining_{false};
+    // 打开的连接，只用于按连接导出指标
+    std::mutex connections_mutex_;
+    std::set<websocketpp::connection_hdl, std::owner_less<websocketpp::connection_hdl>> open_connections_;
+
+    // 房间表，只在加入和回收房间时访问
+    std::mutex rooms_mutex_;
+    std::unordered_map<std::string, std::shared_ptr<GameRoom>> rooms_;
+    uint64_t next_room_id_ = 1;
+
+    // 匹配服务，析构时先于ws_server_停止匹配线程
+    Matchmaker matchmaker_;
+    
+    // 定时器控制
+};
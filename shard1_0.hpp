@@ -0,0 +1,91 @@
+#ifndef SHARD_HPP
+#define SHARD_HPP
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <websocketpp/common/asio.hpp>
+#include "concurrent_queue1_0.hpp"
+
+// 单个分片：一个独立的io_service和一个绑核线程
+// 分到该分片的房间都在这个线程上执行，房间的卡牌和棋盘状态只被这一个线程读写；
+// 其他线程只能通过post（io_service的任务队列）把消息交给它
+class alignas(kCacheLineSize) RoomShard {
+public:
+    RoomShard(size_t index, int cpu)
+        : index_(index), cpu_(cpu), work_(new websocketpp::lib::asio::io_service::work(io_)) {
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    ~RoomShard() {
+        stop();
+    }
+
+    RoomShard(const RoomShard&) = delete;
+    RoomShard& operator=(const RoomShard&) = delete;
+
+    websocketpp::lib::asio::io_service& io_service() { return io_; }
+    size_t index() const { return index_; }
+
+    void stop() {
+        work_.reset();
+        io_.stop();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+private:
+    void run() {
+        if (cpu_ >= 0) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(cpu_, &cpus);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        }
+        io_.run();
+    }
+
+    size_t index_;
+    int cpu_;
+    websocketpp::lib::asio::io_service io_;
+    std::unique_ptr<websocketpp::lib::asio::io_service::work> work_;
+    std::thread thread_;
+};
+
+// 按房间号哈希到分片，同一房间始终落在同一个分片线程上
+class ShardScheduler {
+public:
+    // pin_cpus为true时第i个分片绑定到第 i % CPU数 号核
+    ShardScheduler(size_t shard_count, bool pin_cpus) {
+        unsigned cpu_count = std::max(1u, std::thread::hardware_concurrency());
+        shards_.reserve(shard_count);
+        for (size_t i = 0; i < shard_count; ++i) {
+            int cpu = pin_cpus ? static_cast<int>(i % cpu_count) : -1;
+            shards_.push_back(std::make_unique<RoomShard>(i, cpu));
+        }
+    }
+
+    size_t size() const { return shards_.size(); }
+
+    RoomShard& shard_for(const std::string& room_id) {
+        return *shards_[std::hash<std::string>()(room_id) % shards_.size()];
+    }
+
+    void stop() {
+        for (auto& shard : shards_) {
+            shard->stop();
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<RoomShard>> shards_;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef SUPERVISOR_HPP
+#define SUPERVISOR_HPP
+
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <vector>
+
+// 多进程部署的父进程：fork出N个工作进程并看护
+//  - 工作进程意外退出时按原编号重新拉起
+//  - SIGHUP：逐个重启工作进程（发SIGTERM、等其退出、再拉起下一个），其余进程继续服务
+//  - SIGTERM/SIGINT：通知所有工作进程退出后返回
+// 调用run之前需要阻塞相关信号（block_signals），这样子进程继承后也能用sigwait等待退出信号
+class WorkerSupervisor {
+public:
+    explicit WorkerSupervisor(size_t workers) : pids_(workers, -1) {}
+
+    static sigset_t supervised_signals() {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGCHLD);
+        sigaddset(&signals, SIGHUP);
+        sigaddset(&signals, SIGTERM);
+        sigaddset(&signals, SIGINT);
+        return signals;
+    }
+
+    static void block_signals() {
+        sigset_t signals = supervised_signals();
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    }
+
+    // 父进程中在收到退出信号后返回-1；子进程中立即返回本进程的工作编号
+    int run() {
+        for (size_t i = 0; i < pids_.size(); ++i) {
+            if (spawn(i)) return static_cast<int>(i);
+        }
+
+        sigset_t signals = supervised_signals();
+        for (;;) {
+            int signo = 0;
+            if (sigwait(&signals, &signo) != 0) continue;
+
+            if (signo == SIGCHLD) {
+                if (int worker = reap_and_respawn(); worker >= 0) return worker;
+            } else if (signo == SIGHUP) {
+                std::cout << "[INFO] Rolling restart of " << pids_.size() << " workers" << std::endl;
+                for (size_t i = 0; i < pids_.size(); ++i) {
+                    stop_worker(i);
+                    if (spawn(i)) return static_cast<int>(i);
+                }
+            } else {
+                for (size_t i = 0; i < pids_.size(); ++i) {
+                    if (pids_[i] > 0) kill(pids_[i], SIGTERM);
+                }
+                for (size_t i = 0; i < pids_.size(); ++i) {
+                    if (pids_[i] > 0) waitpid(pids_[i], nullptr, 0);
+                }
+                return -1;
+            }
+        }
+    }
+
+private:
+    // 返回true表示当前处于子进程
+    bool spawn(size_t index) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            return true;
+        }
+        if (pid < 0) {
+            std::cerr << "[ERROR] fork failed for worker " << index << std::endl;
+            return false;
+        }
+        pids_[index] = pid;
+        std::cout << "[INFO] Worker " << index << " started, pid " << pid << std::endl;
+        return false;
+    }
+
+    void stop_worker(size_t index) {
+        if (pids_[index] <= 0) return;
+        kill(pids_[index], SIGTERM);
+        waitpid(pids_[index], nullptr, 0);
+        pids_[index] = -1;
+    }
+
+    int reap_and_respawn() {
+        pid_t pid;
+        int status = 0;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            for (size_t i = 0; i < pids_.size(); ++i) {
+                if (pids_[i] != pid) continue;
+                std::cerr << "[ERROR] Worker " << i << " (pid " << pid << ") exited, restarting" << std::endl;
+                pids_[i] = -1;
+                if (spawn(i)) return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    std::vector<pid_t> pids_;
+};
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef TIMING_WHEEL_HPP
+#define TIMING_WHEEL_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include "concurrent_queue1_0.hpp"
+
+// 分层哈希时间轮（Varghese & Lauck）：4层、每层256个槽，一个tick对应一个最低层槽
+// 定时器按到期tick挂在对应层的槽上，最低层槽转满一圈时把上一层当前槽中的定时器重新分配到下层
+// 添加和删除都是O(1)的双向链表操作，推进一个tick只处理一个槽，不扫描全部定时器
+// 本类不是线程安全的，由单个线程驱动，跨线程使用见TimerService
+class TimingWheel {
+public:
+    static constexpr int kLevels = 4;
+    static constexpr int kSlotBits = 8;
+    static constexpr uint64_t kSlots = uint64_t(1) << kSlotBits;
+    static constexpr uint64_t kSlotMask = kSlots - 1;
+    static constexpr uint64_t kMaxDelta = (uint64_t(1) << (kSlotBits * kLevels)) - 1;
+
+    struct Node {
+        uint64_t expires = 0;              // 到期tick
+        std::function<void()> callback;
+        std::atomic<bool> cancelled{false}; // 取消或已触发；先置位的一方负责把pending减一
+        std::shared_ptr<std::atomic<int64_t>> pending; // 所属TimerService的待触发计数，定时器可能比服务活得久
+        // 以下由驱动线程维护
+        Node* prev = nullptr;
+        Node* next = nullptr;
+        std::shared_ptr<Node> self;        // 挂在轮上期间持有自身
+    };
+
+    explicit TimingWheel(uint64_t now_tick = 0) : current_(now_tick) {
+        for (auto& level : slots_) {
+            for (auto& slot : level) {
+                slot.prev = slot.next = &slot;
+            }
+        }
+    }
+
+    ~TimingWheel() {
+        for (auto& level : slots_) {
+            for (auto& slot : level) {
+                while (slot.next != &slot) {
+                    remove(slot.next);
+                }
+            }
+        }
+    }
+
+    TimingWheel(const TimingWheel&) = delete;
+    TimingWheel& operator=(const TimingWheel&) = delete;
+
+    uint64_t now() const { return current_; }
+    size_t size() const { return size_; }
+
+    // 已到期（expires不晚于当前tick）的定时器在下一个tick触发
+    void add(std::shared_ptr<Node> node) {
+        Node* raw = node.get();
+        raw->self = std::move(node);
+        link(raw);
+        ++size_;
+    }
+
+    void remove(Node* node) {
+        if (!node->self) return;
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+        node->prev = node->next = nullptr;
+        --size_;
+        node->self.reset(); // 可能释放node，放在最后
+    }
+
+    // 推进到now_tick，依次对每个到期的定时器调用on_expire(node)；回调中可以继续add
+    template <typename OnExpire>
+    void advance(uint64_t now_tick, OnExpire&& on_expire) {
+        while (current_ < now_tick) {
+            ++current_;
+            // 低层转完一圈时逐层向下分配
+            for (int level = 1; level < kLevels; ++level) {
+                if (((current_ >> (kSlotBits * (level - 1))) & kSlotMask) != 0) break;
+                cascade(level, (current_ >> (kSlotBits * level)) & kSlotMask);
+            }
+            Node& slot = slots_[0][current_ & kSlotMask];
+            while (slot.next != &slot) {
+                Node* node = slot.next;
+                std::shared_ptr<Node> hold = node->self;
+                remove(node);
+                on_expire(*node);
+            }
+        }
+    }
+
+private:
+    // 新加入的定时器最早在下一个tick触发；分配下层时当前tick的最低层槽还未处理，到期tick等于当前tick的定时器留在当前槽
+    void link(Node* node, bool cascading = false) {
+        uint64_t earliest = cascading ? current_ : current_ + 1;
+        uint64_t expires = node->expires > earliest ? node->expires : earliest;
+        uint64_t delta = expires - current_;
+        if (delta > kMaxDelta) {
+            expires = current_ + kMaxDelta;
+            delta = kMaxDelta;
+        }
+        int level = 0;
+        while (level < kLevels - 1 && delta >= (uint64_t(1) << (kSlotBits * (level + 1)))) {
+            ++level;
+        }
+        Node& slot = slots_[level][(expires >> (kSlotBits * level)) & kSlotMask];
+        node->next = &slot;
+        node->prev = slot.prev;
+        slot.prev->next = node;
+        slot.prev = node;
+    }
+
+    void cascade(int level, uint64_t index) {
+        Node& slot = slots_[level][index];
+        Node list;
+        if (slot.next == &slot) return;
+        // 整个槽摘下后逐个重新挂到下层
+        list.next = slot.next;
+        list.prev = slot.prev;
+        list.next->prev = &list;
+        list.prev->next = &list;
+        slot.prev = slot.next = &slot;
+        while (list.next != &list) {
+            Node* node = list.next;
+            list.next = node->next;
+            node->next->prev = &list;
+            link(node, true);
+        }
+    }
+
+    uint64_t current_;
+    size_t size_ = 0;
+    std::array<std::array<Node, kSlots>, kLevels> slots_; // 每个槽是一个哨兵节点
+};
+
+// 跨线程的定时器服务：任意线程schedule/cancel，一个后台线程驱动时间轮
+// schedule只向MPSC队列推入一个节点；cancel只置位一个原子标志并把待触发计数减一，不需要在轮上查找，
+// 已取消的节点留在槽中直到到期时被跳过（还在入队队列中的直接丢弃），不再计入pending()
+// 回调在定时器线程上执行，应当很短，通常只是把任务投递到房间的strand
+class TimerService {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Handle = std::shared_ptr<TimingWheel::Node>;
+
+    explicit TimerService(std::chrono::milliseconds tick = std::chrono::milliseconds(10))
+        : tick_(tick), start_(Clock::now()) {
+        worker_ = std::thread([this]() { run(); });
+    }
+
+    ~TimerService() { stop(); }
+
+    TimerService(const TimerService&) = delete;
+    TimerService& operator=(const TimerService&) = delete;
+
+    Handle schedule(std::chrono::milliseconds delay, std::function<void()> callback) {
+        auto node = std::make_shared<TimingWheel::Node>();
+        // 向上取整到tick，保证不早于delay触发
+        auto deadline = Clock::now() + delay - start_;
+        node->expires = static_cast<uint64_t>((deadline + tick_ - Clock::duration(1)) / tick_);
+        node->callback = std::move(callback);
+        node->pending = pending_;
+        pending_->fetch_add(1, std::memory_order_relaxed);
+        incoming_.push(node);
+        return node;
+    }
+
+    static void cancel(const Handle& handle) {
+        if (handle && !handle->cancelled.exchange(true, std::memory_order_acq_rel)) {
+            handle->pending->fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    // 已安排、未取消且尚未触发的定时器数
+    int64_t pending() const { return pending_->load(std::memory_order_relaxed); }
+
+    void stop() {
+        running_.store(false, std::memory_order_release);
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+    }
+
+private:
+    void run() {
+        TimingWheel wheel(0);
+        Handle node;
+        auto next_tick = start_ + tick_;
+        while (running_.load(std::memory_order_acquire)) {
+            std::this_thread::sleep_until(next_tick);
+            while (incoming_.pop(node)) {
+                if (node->cancelled.load(std::memory_order_acquire)) {
+                    node->callback = nullptr;
+                    continue;
+                }
+                wheel.add(std::move(node));
+            }
+            uint64_t now_tick = static_cast<uint64_t>((Clock::now() - start_) / tick_);
+            wheel.advance(now_tick, [](TimingWheel::Node& expired) {
+                if (!expired.cancelled.exchange(true, std::memory_order_acq_rel)) {
+                    expired.pending->fetch_sub(1, std::memory_order_relaxed);
+                    expired.callback();
+                }
+                expired.callback = nullptr;
+            });
+            next_tick = start_ + tick_ * (now_tick + 1);
+        }
+    }
+
+    const Clock::duration tick_;
+    const Clock::time_point start_;
+    MpscQueue<Handle> incoming_;
+    const std::shared_ptr<std::atomic<int64_t>> pending_ = std::make_shared<std::atomic<int64_t>>(0);
+    std::atomic<bool> running_{true};
+    std::thread worker_;
+};
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// 单条上行消息的处理轨迹：从I/O线程收到帧开始，经解析、strand排队、出牌解析、对战结算、序列化到下发
+// 每个阶段记为一个带起止时间的span，同一线程上嵌套的span构成一棵树
+// 轨迹对象随消息投递到房间strand，处理期间挂在线程局部的current()上，TraceSpan据此记录；没有轨迹时TraceSpan什么也不做
+class TurnTrace {
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr size_t kMaxSpans = 48;
+
+    struct Span {
+        const char* name = "";
+        int parent = -1;
+        int64_t start_ns = 0;  // 相对origin
+        int64_t end_ns = -1;   // -1表示尚未结束
+    };
+
+    explicit TurnTrace(Clock::time_point origin = Clock::now()) : origin_(origin) {}
+
+    // 开始一个span，父span为当前最内层未结束的span；超出容量时返回-1并计数
+    int begin(const char* name) {
+        if (count_ == kMaxSpans) {
+            ++overflow_;
+            return -1;
+        }
+        Span& span = spans_[count_];
+        span.name = name;
+        span.parent = open_;
+        span.start_ns = since_origin(Clock::now());
+        span.end_ns = -1;
+        open_ = static_cast<int>(count_);
+        return static_cast<int>(count_++);
+    }
+
+    void end(int index) {
+        if (index < 0) return;
+        spans_[index].end_ns = since_origin(Clock::now());
+        open_ = spans_[index].parent;
+    }
+
+    // 记录一个已知起止时间的span（如I/O线程上的解析和strand排队），父span为当前最内层的span
+    void add(const char* name, Clock::time_point start, Clock::time_point end) {
+        if (count_ == kMaxSpans) {
+            ++overflow_;
+            return;
+        }
+        spans_[count_++] = Span{name, open_, since_origin(start), since_origin(end)};
+    }
+
+    int64_t elapsed_us() const { return since_origin(Clock::now()) / 1000; }
+
+    // 缩进的span树：每行 名字 +起始us 耗时us
+    std::string render() const {
+        std::string out;
+        for (size_t i = 0; i < count_; ++i) {
+            if (spans_[i].parent < 0) render_span(out, static_cast<int>(i), 0);
+        }
+        if (overflow_) {
+            out += "(" + std::to_string(overflow_) + " spans not recorded)\n";
+        }
+        return out;
+    }
+
+    static TurnTrace*& current() {
+        thread_local TurnTrace* trace = nullptr;
+        return trace;
+    }
+
+    // 在当前线程上激活一条轨迹，析构时恢复
+    class Scope {
+    public:
+        explicit Scope(TurnTrace* trace) : prev_(current()) { current() = trace; }
+        ~Scope() { current() = prev_; }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        TurnTrace* prev_;
+    };
+
+private:
+    int64_t since_origin(Clock::time_point t) const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(t - origin_).count();
+    }
+
+    void render_span(std::string& out, int index, int depth) const {
+        const Span& span = spans_[index];
+        char line[160];
+        if (span.end_ns >= 0) {
+            snprintf(line, sizeof(line), "%*s%s +%lldus %lldus\n", depth * 2, "", span.name,
+                     static_cast<long long>(span.start_ns / 1000),
+                     static_cast<long long>((span.end_ns - span.start_ns) / 1000));
+        } else {
+            snprintf(line, sizeof(line), "%*s%s +%lldus (open)\n", depth * 2, "", span.name,
+                     static_cast<long long>(span.start_ns / 1000));
+        }
+        out += line;
+        for (size_t i = index + 1; i < count_; ++i) {
+            if (spans_[i].parent == index) render_span(out, static_cast<int>(i), depth + 1);
+        }
+    }
+
+    Clock::time_point origin_;
+    std::array<Span, kMaxSpans> spans_;
+    size_t count_ = 0;
+    size_t overflow_ = 0;
+    int open_ = -1;
+};
+
+// 在当前轨迹上记录一个作用域span
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name)
+        : trace_(TurnTrace::current()), index_(trace_ ? trace_->begin(name) : -1) {}
+    ~TraceSpan() {
+        if (trace_) trace_->end(index_);
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    TurnTrace* trace_;
+    int index_;
+};
+
+// 慢回合日志：处理时间超过阈值的消息连同span树和房间状态追加到单独的文件
+// 写文件在后台线程上进行，房间strand只负责入队；后台线程在第一条记录到来时启动，析构时写完剩余记录并join
+// 文件打不开时记录留在内存中，每隔kRetryInterval重试，最多保留kMaxPending条，更早的丢弃并计数
+class SlowTurnLog {
+public:
+    static constexpr size_t kMaxPending = 1024;
+
+    static SlowTurnLog& shared() {
+        static SlowTurnLog log;
+        return log;
+    }
+
+    ~SlowTurnLog() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        if (worker_.joinable()) worker_.join();
+    }
+
+    // threshold_us为0时关闭
+    void configure(uint64_t threshold_us, std::string path) {
+        threshold_us_.store(threshold_us, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(mutex_);
+        path_ = std::move(path);
+    }
+
+    bool enabled() const { return threshold_us_.load(std::memory_order_relaxed) != 0; }
+
+    bool is_slow(const TurnTrace& trace) const {
+        uint64_t threshold = threshold_us_.load(std::memory_order_relaxed);
+        return threshold != 0 && static_cast<uint64_t>(trace.elapsed_us()) >= threshold;
+    }
+
+    // 只有慢回合才会调用，加锁的开销可以忽略
+    void submit(std::string record) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) return;
+            pending_.push_back(std::move(record));
+            trim();
+            if (!worker_.joinable()) worker_ = std::thread([this]() { run(); });
+        }
+        wake_.notify_one();
+    }
+
+    // 因积压过多而丢弃的记录数
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr auto kRetryInterval = std::chrono::seconds(1);
+
+    SlowTurnLog() = default;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            wake_.wait(lock, [this]() { return stopping_ || !pending_.empty(); });
+            if (pending_.empty()) return;
+            std::deque<std::string> batch;
+            batch.swap(pending_);
+            std::string path = path_;
+            lock.unlock();
+
+            FILE* file = fopen(path.c_str(), "a");
+            if (file) {
+                for (const auto& record : batch) fwrite(record.data(), 1, record.size(), file);
+                fclose(file);
+            }
+
+            lock.lock();
+            if (!file) {
+                // 放回队首，保持先后顺序，稍后重试；退出时仍打不开就放弃
+                pending_.insert(pending_.begin(), std::make_move_iterator(batch.begin()),
+                                std::make_move_iterator(batch.end()));
+                trim();
+                if (stopping_) return;
+                wake_.wait_for(lock, kRetryInterval, [this]() { return stopping_; });
+            }
+        }
+    }
+
+    // 调用方持有mutex_
+    void trim() {
+        while (pending_.size() > kMaxPending) {
+            pending_.pop_front();
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<uint64_t> threshold_us_{20000};
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::string path_ = "slow_turns.log";
+    std::deque<std::string> pending_;
+    bool stopping_ = false;
+    std::atomic<uint64_t> dropped_{0};
+    std::thread worker_;
+};
+
+#endif
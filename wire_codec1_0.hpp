@@ -0,0 +1,237 @@
+#ifndef WIRE_CODEC_HPP
+#define WIRE_CODEC_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// 连接的线上编码，握手时通过Sec-WebSocket-Protocol协商
+// 不带子协议的客户端（网页和PyQt客户端）保持JSON文本帧；
+// 请求xemk.cbor或xemk.msgpack的客户端收发二进制帧，消息类型和字段与JSON完全相同
+enum class WireCodec : uint8_t {
+    json = 0,
+    cbor = 1,
+    msgpack = 2,
+};
+
+namespace wire {
+
+inline const char* subprotocol_name(WireCodec codec) {
+    switch (codec) {
+    case WireCodec::cbor: return "xemk.cbor";
+    case WireCodec::msgpack: return "xemk.msgpack";
+    default: return "";
+    }
+}
+
+// 按客户端给出的顺序选第一个支持的子协议，没有则使用JSON
+inline WireCodec negotiate(const std::vector<std::string>& requested) {
+    for (const auto& name : requested) {
+        if (name == subprotocol_name(WireCodec::cbor)) return WireCodec::cbor;
+        if (name == subprotocol_name(WireCodec::msgpack)) return WireCodec::msgpack;
+    }
+    return WireCodec::json;
+}
+
+inline bool is_binary(WireCodec codec) {
+    return codec != WireCodec::json;
+}
+
+inline std::string encode(WireCodec codec, const nlohmann::json& message) {
+    switch (codec) {
+    case WireCodec::cbor: {
+        std::vector<std::uint8_t> bytes = nlohmann::json::to_cbor(message);
+        return std::string(bytes.begin(), bytes.end());
+    }
+    case WireCodec::msgpack: {
+        std::vector<std::uint8_t> bytes = nlohmann::json::to_msgpack(message);
+        return std::string(bytes.begin(), bytes.end());
+    }
+    default:
+        return message.dump();
+    }
+}
+
+// 解析失败时抛出nlohmann::json::exception，与json::parse一致
+inline nlohmann::json decode(WireCodec codec, const std::string& payload) {
+    switch (codec) {
+    case WireCodec::cbor: return nlohmann::json::from_cbor(payload);
+    case WireCodec::msgpack: return nlohmann::json::from_msgpack(payload);
+    default: return nlohmann::json::parse(payload);
+    }
+}
+
+// 已编码的消息换一种编码，只在玩家换了编码重连、补发旧消息时用到
+inline std::string transcode(WireCodec from, WireCodec to, const std::string& payload) {
+    if (from == to) return payload;
+    return encode(to, decode(from, payload));
+}
+
+namespace detail {
+
+inline void put_be(std::string& out, uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i) {
+        out += static_cast<char>((value >> (i * 8)) & 0xff);
+    }
+}
+
+inline void cbor_head(std::string& out, uint8_t major, uint64_t n) {
+    uint8_t m = static_cast<uint8_t>(major << 5);
+    if (n < 24) {
+        out += static_cast<char>(m | n);
+    } else if (n <= 0xff) {
+        out += static_cast<char>(m | 24);
+        put_be(out, n, 1);
+    } else if (n <= 0xffff) {
+        out += static_cast<char>(m | 25);
+        put_be(out, n, 2);
+    } else {
+        out += static_cast<char>(m | 26);
+        put_be(out, n, 4);
+    }
+}
+
+inline void cbor_text(std::string& out, const std::string& s) {
+    cbor_head(out, 3, s.size());
+    out += s;
+}
+
+// 只用于短的固定键名（<32字节）
+inline void msgpack_fixstr(std::string& out, const std::string& s) {
+    out += static_cast<char>(0xa0 | s.size());
+    out += s;
+}
+
+inline void msgpack_array_head(std::string& out, uint64_t n) {
+    if (n < 16) {
+        out += static_cast<char>(0x90 | n);
+    } else if (n <= 0xffff) {
+        out += static_cast<char>(0xdc);
+        put_be(out, n, 2);
+    } else {
+        out += static_cast<char>(0xdd);
+        put_be(out, n, 4);
+    }
+}
+
+} // namespace detail
+
+// 手工拼接已编码片段的数组，调用方事先知道元素个数（CBOR/MessagePack的数组头需要）
+// 用法：begin_array(n)，每个元素前array_separator(i)再追加元素，最后end_array
+inline void begin_array(WireCodec codec, std::string& out, size_t n) {
+    switch (codec) {
+    case WireCodec::cbor: detail::cbor_head(out, 4, n); break;
+    case WireCodec::msgpack: detail::msgpack_array_head(out, n); break;
+    default: out += '['; break;
+    }
+}
+
+inline void array_separator(WireCodec codec, std::string& out, size_t index) {
+    if (codec == WireCodec::json && index > 0) out += ',';
+}
+
+inline void end_array(WireCodec codec, std::string& out) {
+    if (codec == WireCodec::json) out += ']';
+}
+
+inline void append_null(WireCodec codec, std::string& out) {
+    switch (codec) {
+    case WireCodec::cbor: out += static_cast<char>(0xf6); break;
+    case WireCodec::msgpack: out += static_cast<char>(0xc0); break;
+    default: out += "null"; break;
+    }
+}
+
+// 键名加已编码的值，键名只用代码中的固定字段名
+using RawFields = std::vector<std::pair<std::string, std::string>>;
+
+// 向已编码的JSON对象追加字段，不重新序列化已有内容
+// CBOR/MessagePack只改写单字节的map头；字段数超出单字节头的范围时退回解码后重新编码
+inline std::string splice_fields(WireCodec codec, std::string object, const RawFields& fields) {
+    if (fields.empty()) return object;
+    switch (codec) {
+    case WireCodec::cbor:
+    case WireCodec::msgpack: {
+        bool cbor = codec == WireCodec::cbor;
+        uint8_t base = cbor ? 0xa0 : 0x80;
+        uint8_t limit = cbor ? 24 : 16;
+        uint8_t head = object.empty() ? 0 : static_cast<uint8_t>(object[0]);
+        size_t count = head - base;
+        if (object.empty() || head < base || count + fields.size() >= limit) {
+            nlohmann::json message = decode(codec, object);
+            for (const auto& [key, value] : fields) {
+                message[key] = decode(codec, value);
+            }
+            return encode(codec, message);
+        }
+        object[0] = static_cast<char>(base + count + fields.size());
+        for (const auto& [key, value] : fields) {
+            if (cbor) {
+                detail::cbor_text(object, key);
+            } else {
+                detail::msgpack_fixstr(object, key);
+            }
+            object += value;
+        }
+        return object;
+    }
+    default: {
+        object.pop_back(); // '}'
+        bool first = object.size() == 1;
+        for (const auto& [key, value] : fields) {
+            if (!first) object += ',';
+            first = false;
+            object += '"';
+            object += key;
+            object += "\":";
+            object += value;
+        }
+        object += '}';
+        return object;
+    }
+    }
+}
+
+// 把若干条已编码的消息拼成 {"type":type,"messages":[...]}，不重新序列化各条消息
+inline std::string encode_envelope(WireCodec codec, const std::string& type,
+                                   const std::vector<const std::string*>& items) {
+    size_t total = 32 + type.size();
+    for (const auto* item : items) total += item->size() + 1;
+    std::string out;
+    out.reserve(total);
+    switch (codec) {
+    case WireCodec::cbor:
+        out += static_cast<char>(0xa2);
+        detail::cbor_text(out, "type");
+        detail::cbor_text(out, type);
+        detail::cbor_text(out, "messages");
+        detail::cbor_head(out, 4, items.size());
+        for (const auto* item : items) out += *item;
+        break;
+    case WireCodec::msgpack:
+        out += static_cast<char>(0x82);
+        detail::msgpack_fixstr(out, "type");
+        detail::msgpack_fixstr(out, type);
+        detail::msgpack_fixstr(out, "messages");
+        detail::msgpack_array_head(out, items.size());
+        for (const auto* item : items) out += *item;
+        break;
+    default:
+        out += "{\"type\":\"";
+        out += type;
+        out += "\",\"messages\":[";
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (i > 0) out += ',';
+            out += *items[i];
+        }
+        out += "]}";
+        break;
+    }
+    return out;
+}
+
+} // namespace wire
+
+#endif